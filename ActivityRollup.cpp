@@ -0,0 +1,100 @@
+#include "ActivityRollup.h"
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QVariant>
+
+bool ActivityRollup::Key::operator== (const Key& other) const {
+	return project    == other.project   && user   == other.user && eventType == other.eventType &&
+		   resolution == other.resolution && bucket == other.bucket;
+}
+
+uint qHash(const ActivityRollup::Key& key) {
+	return qHash(key.user) ^ qHash(key.eventType) ^ qHash(key.bucket) ^ qHash(key.resolution);
+}
+
+ActivityRollup::ActivityRollup(QObject* parent) : QObject(parent)
+{
+	connect(&timer, SIGNAL(timeout()), this, SLOT(flush()));
+	timer.start(FlushInterval);
+}
+
+ActivityRollup::~ActivityRollup() {
+	flush();
+}
+
+void ActivityRollup::add(const QString& project, const QString& user, const QString& eventType,
+						 const QDateTime& time)
+{
+	Key key;
+	key.project    = project;
+	key.user       = user;
+	key.eventType  = eventType;
+	key.resolution = "HOUR";
+	key.bucket     = getBucket(time, key.resolution);
+	++pending[key];
+
+	key.resolution = "DAY";
+	key.bucket     = getBucket(time, key.resolution);
+	++pending[key];
+}
+
+// the pending counts are keyed by the old name, so they go to the db first
+void ActivityRollup::rename(const QString& oldName, const QString& newName)
+{
+	flush();
+
+	// a row of the other name in the same bucket
+	QString other = "select %1 from Activity Other where Other.Client = \"%2\" and \
+					 Other.Project = Activity.Project and Other.Event = Activity.Event and \
+					 Other.Resolution = Activity.Resolution and Other.Bucket = Activity.Bucket";
+	QString oldRow = other.arg("Other.Count", oldName);
+	QString newRow = other.arg("*",           newName);
+
+	QSqlDatabase database = QSqlDatabase::database();
+	database.transaction();
+	QSqlQuery query;
+	query.exec(QObject::tr("update Activity set Count = Count + (%1) where Client = \"%2\" and exists (%1)")
+			   .arg(oldRow, newName));
+	query.exec(QObject::tr("delete from Activity where Client = \"%1\" and exists (%2)")
+			   .arg(oldName, newRow));
+	query.exec(QObject::tr("update Activity set Client = \"%1\" where Client = \"%2\"")
+			   .arg(newName).arg(oldName));
+	database.commit();
+}
+
+QString ActivityRollup::getBucket(const QDateTime& time, const QString& resolution) {
+	return time.toString(resolution == "DAY" ? "yyyy-MM-dd" : "yyyy-MM-dd HH");
+}
+
+void ActivityRollup::flush()
+{
+	if(pending.isEmpty())
+		return;
+
+	QSqlDatabase database = QSqlDatabase::database();
+	database.transaction();
+	QSqlQuery insert, update;
+	insert.prepare("insert or ignore into Activity values (?, ?, ?, ?, ?, 0)");
+	update.prepare("update Activity set Count = Count + ? where Project = ? and Client = ? \
+				   and Event = ? and Resolution = ? and Bucket = ?");
+	for(QHash<Key, int>::ConstIterator it = pending.begin(); it != pending.end(); ++it)
+	{
+		const Key& key = it.key();
+		insert.addBindValue(key.project);
+		insert.addBindValue(key.user);
+		insert.addBindValue(key.eventType);
+		insert.addBindValue(key.resolution);
+		insert.addBindValue(key.bucket);
+		insert.exec();
+
+		update.addBindValue(it.value());
+		update.addBindValue(key.project);
+		update.addBindValue(key.user);
+		update.addBindValue(key.eventType);
+		update.addBindValue(key.resolution);
+		update.addBindValue(key.bucket);
+		update.exec();
+	}
+	database.commit();
+	pending.clear();
+}
@@ -0,0 +1,47 @@
+#ifndef ActivityRollup_h__
+#define ActivityRollup_h__
+
+#include <QObject>
+#include <QHash>
+#include <QTimer>
+#include <QDateTime>
+
+// Maintains the Activity table: counts of events per project, user, event type and hour/day
+// Counts are accumulated in memory, and flushed in one transaction every few seconds
+// Format of buckets: yyyy-MM-dd HH for HOUR, yyyy-MM-dd for DAY, i.e., prefixes of Logs.Time
+class ActivityRollup : public QObject
+{
+	Q_OBJECT
+
+	struct Key
+	{
+		QString project;
+		QString user;
+		QString eventType;
+		QString resolution;
+		QString bucket;
+		bool operator== (const Key& other) const;
+	};
+	friend uint qHash(const Key& key);
+
+public:
+	ActivityRollup(QObject* parent = 0);
+	~ActivityRollup();
+
+	void add(const QString& project, const QString& user, const QString& eventType,
+			 const QDateTime& time);
+	void rename(const QString& oldName, const QString& newName);   // merged if newName has counts
+	static QString getBucket(const QDateTime& time, const QString& resolution);
+
+public slots:
+	void flush();
+
+public:
+	static const int FlushInterval = 5000;   // msecs
+
+private:
+	QHash<Key, int> pending;
+	QTimer          timer;
+};
+
+#endif // ActivityRollup_h__
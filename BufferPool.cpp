@@ -0,0 +1,58 @@
+#include "BufferPool.h"
+
+QList<QByteArray> BufferPool::freeLists[NumClasses];
+qint64            BufferPool::pooledBytes = 0;
+
+int BufferPool::getClass(int size)
+{
+	int result = 0;
+	while((1 << (result + MinShift)) < size)
+		if(++result == NumClasses)
+			return -1;
+	return result;
+}
+
+QByteArray BufferPool::acquire(int size)
+{
+	if(size <= 0)
+		return QByteArray();
+
+	int sizeClass = getClass(size);
+	if(sizeClass < 0)
+		return QByteArray(size, '\0');
+
+	QByteArray result;
+	QList<QByteArray>& freeList = freeLists[sizeClass];
+	if(freeList.isEmpty())
+		result.reserve(1 << (sizeClass + MinShift));
+	else
+	{
+		result = freeList.takeLast();
+		pooledBytes -= result.capacity();
+	}
+	result.resize(size);
+	return result;
+}
+
+void BufferPool::release(QByteArray& buffer)
+{
+	int capacity  = buffer.capacity();
+	int sizeClass = getClass(capacity);
+	if(sizeClass >= 0 && capacity == 1 << (sizeClass + MinShift) && buffer.isDetached())
+	{
+		QList<QByteArray>& freeList = freeLists[sizeClass];
+		if(freeList.isEmpty() || (freeList.size() + 1) * capacity <= MaxPooledBytesPerClass)
+		{
+			freeList << buffer;
+			pooledBytes += capacity;
+		}
+	}
+	buffer = QByteArray();
+}
+
+void BufferPool::trim()
+{
+	for(int i = 0; i < NumClasses; ++i)
+		freeLists[i].clear();
+	pooledBytes = 0;
+}
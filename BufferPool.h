@@ -0,0 +1,32 @@
+#ifndef BufferPool_h__
+#define BufferPool_h__
+
+#include <QByteArray>
+#include <QList>
+
+// Receive buffers in power-of-2 size classes, from 64 bytes to MaxBufferSize of Connection
+// A buffer is over half full (but in the smallest class), so resizing it in its class never reallocates
+// A buffer goes back to the pool after its packet is processed, unless a handler has kept a copy
+// Each class keeps at most 1MB (or one buffer) free; the rest is freed
+// For the main thread only
+class BufferPool
+{
+public:
+	static QByteArray acquire(int size);   // of the size, its capacity is the size class
+	static void release(QByteArray& buffer);   // and clears it
+	static void trim();                    // frees all the pooled ones
+	static qint64 getPooledBytes() { return pooledBytes; }
+
+private:
+	static int getClass(int size);         // -1 if too large
+
+private:
+	static const int MinShift   = 6;       // 64 bytes
+	static const int NumClasses = 17;      // to 4MB
+	static const int MaxPooledBytesPerClass = 1024 * 1024;
+
+	static QList<QByteArray> freeLists[NumClasses];
+	static qint64            pooledBytes;
+};
+
+#endif // BufferPool_h__
@@ -0,0 +1,390 @@
+#include "Cluster.h"
+#include "Connection.h"
+#include "Fields.h"
+#include <QTcpSocket>
+#include <QHostInfo>
+#include <QDebug>
+
+Cluster::Cluster(QObject* parent) : QObject(parent)
+{
+	numRelayed = 0;
+	numSkipped = 0;
+	clock.start();
+	connect(&server,         SIGNAL(newConnection()), this, SLOT(onNewLink()));
+	connect(&relinkTimer,    SIGNAL(timeout()),       this, SLOT(onRelink()));
+	connect(&heartbeatTimer, SIGNAL(timeout()),       this, SLOT(onHeartbeat()));
+	setHeartbeatInterval(HeartbeatInterval);
+}
+
+// the sockets are deleted later, with their parents, and must not call back
+Cluster::~Cluster()
+{
+	foreach(Link* link, links)
+	{
+		link->socket->disconnect(this);
+		delete link;
+	}
+}
+
+bool Cluster::listen(quint16 port)
+{
+	if(port == 0)
+		return false;
+	if(nodeName.isEmpty())
+		nodeName = QString("%1:%2").arg(QHostInfo::localHostName()).arg(port);
+	if(!server.listen(QHostAddress::Any, port))
+		return false;
+	heartbeatTimer.start();
+	return true;
+}
+
+void Cluster::setPeers(const QStringList& addresses)
+{
+	peers = addresses;
+	onRelink();
+	if(!peers.isEmpty())
+	{
+		relinkTimer.start(RelinkInterval);
+		heartbeatTimer.start();
+	}
+}
+
+void Cluster::setHeartbeatInterval(int msecs)
+{
+	heartbeatTimer.setInterval(msecs);
+	linkTimeout = 3 * msecs;
+}
+
+// link to the peers not linked
+void Cluster::onRelink()
+{
+	foreach(const QString& address, peers)
+		if(!outbound.contains(address))
+		{
+			int colon = address.lastIndexOf(':');
+			QTcpSocket* socket = new QTcpSocket(this);
+			addLink(socket, address);
+			connect(socket, SIGNAL(connected()), this, SLOT(onConnected()));
+			socket->connectToHost(address.left(colon), address.mid(colon + 1).toUShort());
+		}
+}
+
+void Cluster::onNewLink()
+{
+	while(server.hasPendingConnections())
+	{
+		QTcpSocket* socket = server.nextPendingConnection();
+		addLink(socket, QString());
+		send(socket, "NODE", nodeName.toUtf8());
+	}
+}
+
+void Cluster::addLink(QTcpSocket* socket, const QString& address)
+{
+	Link* link = new Link;
+	link->socket  = socket;
+	link->address = address;
+	link->lastReceived = clock.elapsed();
+	links.insert(socket, link);
+	if(!address.isEmpty())
+		outbound.insert(address, socket);
+	socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);   // events are small
+	socket->setSocketOption(QAbstractSocket::KeepAliveOption, 1);
+	connect(socket, SIGNAL(readyRead()),    this, SLOT(onReadyRead()));
+	connect(socket, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
+	connect(socket, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(onDisconnected()));
+}
+
+// introduce this node, and its users
+void Cluster::onConnected()
+{
+	QTcpSocket* socket = static_cast<QTcpSocket*>(sender());
+	send(socket, "NODE", nodeName.toUtf8());
+	for(QHash<QString, QString>::ConstIterator it = locals.begin(); it != locals.end(); ++it)
+		send(socket, "JOIN", it.value().toUtf8() + Connection::Delimiter1 + it.key().toUtf8());
+}
+
+// the users of a lost peer are offline, until it links again and tells
+// a link replaced by a newer one of its peer changes nothing
+void Cluster::onDisconnected()
+{
+	QTcpSocket* socket = static_cast<QTcpSocket*>(sender());
+	Link* link = links.take(socket);
+	if(link == 0)   // an error may be followed by disconnected()
+		return;
+	behind.removeAll(socket);
+
+	if(!link->address.isEmpty())
+	{
+		outbound.remove(link->address);
+		if(routes.value(link->node) == socket)
+		{
+			routes.remove(link->node);
+			dropNode(link->node);   // its users cannot be reached
+		}
+	}
+	else if(!link->node.isEmpty() && nodes.value(link->node).link == socket)
+		nodes.remove(link->node);
+	socket->deleteLater();
+	delete link;
+}
+
+// its inbound link is closed too, so the peer relinks, and tells its users again
+void Cluster::dropNode(const QString& name)
+{
+	QTcpSocket* link = nodes.take(name).link;
+	if(link != 0)
+		link->abort();
+}
+
+// beat on every link, and drop the silent ones, e.g., of a crashed or partitioned peer
+void Cluster::onHeartbeat()
+{
+	qint64 now = clock.elapsed();
+	foreach(QTcpSocket* socket, links.keys())
+	{
+		Link* link = links.value(socket);   // an abort may have removed others
+		if(link == 0 || socket->state() != QAbstractSocket::ConnectedState)
+			continue;   // connecting ones are timed out by the socket
+		if(now - link->lastReceived > linkTimeout)
+		{
+			qDebug() << "Dropping the silent link of node" << link->node;
+			socket->abort();   // removes it
+		}
+		else
+			send(socket, "BEAT", QByteArray());
+	}
+}
+
+// frames header#size#body
+void Cluster::onReadyRead()
+{
+	QTcpSocket* socket = static_cast<QTcpSocket*>(sender());
+	Link* link = links.value(socket);
+	if(link == 0)
+		return;
+
+	link->lastReceived = clock.elapsed();
+	QByteArray& buffer = link->buffer;
+	buffer.append(socket->readAll());
+	int pos = 0;
+	forever
+	{
+		int headerEnd = buffer.indexOf(Connection::Delimiter1, pos);
+		int sizeEnd   = headerEnd < 0 ? -1 : buffer.indexOf(Connection::Delimiter1, headerEnd + 1);
+		if(sizeEnd < 0)
+			break;
+		bool ok;
+		int size = Field(buffer.constData() + headerEnd + 1, sizeEnd - headerEnd - 1).toInt(&ok);
+		if(!ok || size < 0 || size > MaxPacketSize || headerEnd - pos > Connection::MaxTokenSize)
+		{
+			qDebug() << "Bad packet from node" << link->node;
+			socket->abort();
+			return;
+		}
+		if(buffer.size() < sizeEnd + 1 + size)   // wait for the rest
+			break;
+		process(link, buffer.mid(pos, headerEnd - pos), buffer.mid(sizeEnd + 1, size));
+		pos = sizeEnd + 1 + size;
+	}
+	buffer.remove(0, pos);
+}
+
+void Cluster::process(Link* link, const QByteArray& header, const QByteArray& body)
+{
+	if(header == "BEAT")
+		return;
+	if(header == "NODE")
+	{
+		link->node = QString::fromUtf8(body);
+		if(!link->address.isEmpty())
+			routes.insert(link->node, link->socket);
+		else
+		{
+			QTcpSocket* previous = nodes.value(link->node).link;
+			Node node;   // its users follow
+			node.link = link->socket;
+			nodes.insert(link->node, node);
+			if(previous != 0)   // replaced, not closed yet
+				previous->abort();
+		}
+		return;
+	}
+	if(link->node.isEmpty() || !link->address.isEmpty())   // only the peers send on their links
+		return;
+	if(nodes.value(link->node).link != link->socket)   // dropped, or replaced
+		return;
+
+	Node& node = nodes[link->node];
+	int first = body.indexOf(Connection::Delimiter1);
+	if(header == "LEAVE")
+		return leave(node, QString::fromUtf8(body));
+	if(first < 0)
+		return;
+	if(header == "JOIN")
+		join(node, QString::fromUtf8(body.mid(first + 1)), QString::fromUtf8(body.left(first)));
+	else if(header == "EVENT")
+	{
+		Fields fields(Field(body.constData() + first + 1, body.size() - first - 1),
+					  Connection::Delimiter1);   // user#type#parameters#time
+		if(fields.size() < 4)
+			return;
+		TeamRadarEvent event(fields[0].toString(), fields[1].toString(),
+							 fields[2].toString(), fields[3].toString());
+		event.setBody(fields[0].toByteArray(), fields[1], fields[2]);
+		emit eventReceived(QString::fromUtf8(body.left(first)), event);
+	}
+	else
+	{
+		int second = body.indexOf(Connection::Delimiter1, first + 1);
+		if(second < 0)
+			return;
+		QString    source = QString::fromUtf8(body.mid(first + 1, second - first - 1));
+		QByteArray packet = body.mid(second + 1);
+		if(header == "GROUP")
+			emit groupReceived(QString::fromUtf8(body.left(first)), source, packet);
+		else if(header == "DELIVER")
+			emit deliverReceived(body.left(first).split(Connection::Delimiter2), source, packet);
+	}
+}
+
+void Cluster::join(Node& node, const QString& user, const QString& project)
+{
+	leave(node, user);
+	node.projects.insert(user, project);
+	++node.counts[project];
+}
+
+void Cluster::leave(Node& node, const QString& user)
+{
+	QHash<QString, QString>::Iterator it = node.projects.find(user);
+	if(it == node.projects.end())
+		return;
+	if(--node.counts[it.value()] == 0)
+		node.counts.remove(it.value());
+	node.projects.erase(it);
+}
+
+void Cluster::join(const QString& user, const QString& project)
+{
+	locals.insert(user, project);
+	sendToAll("JOIN", project.toUtf8() + Connection::Delimiter1 + user.toUtf8());
+}
+
+void Cluster::leave(const QString& user)
+{
+	if(locals.remove(user) > 0)
+		sendToAll("LEAVE", user.toUtf8());
+}
+
+void Cluster::relayEvent(const QString& project, const TeamRadarEvent& event)
+{
+	if(routes.isEmpty())
+		return;
+	QByteArray body;
+	for(QHash<QString, Node>::ConstIterator it = nodes.begin(); it != nodes.end(); ++it)
+		if(QTcpSocket* socket = routes.value(it.key()))
+		{
+			if(it->counts.value(project) == 0)
+			{
+				++numSkipped;
+				continue;
+			}
+			if(body.isEmpty())   // encoded once for all the peers
+				body = project.toUtf8() + Connection::Delimiter1 + event.getBody();
+			send(socket, "EVENT", body);
+		}
+}
+
+void Cluster::relayGroup(const QString& project, const QString& source, const QByteArray& packet)
+{
+	if(routes.isEmpty())
+		return;
+	QByteArray body;
+	for(QHash<QString, Node>::ConstIterator it = nodes.begin(); it != nodes.end(); ++it)
+		if(QTcpSocket* socket = routes.value(it.key()))
+		{
+			if(it->counts.value(project) == 0)
+			{
+				++numSkipped;
+				continue;
+			}
+			if(body.isEmpty())
+				body = project.toUtf8() + Connection::Delimiter1 + source.toUtf8() + Connection::Delimiter1 + packet;
+			send(socket, "GROUP", body);
+		}
+}
+
+// each peer is sent only the recipients online on it
+void Cluster::deliver(const QList<QByteArray>& recipients, const QString& source, const QByteArray& packet)
+{
+	for(QHash<QString, Node>::ConstIterator it = nodes.begin(); it != nodes.end(); ++it)
+	{
+		QTcpSocket* socket = routes.value(it.key());
+		if(socket == 0)
+			continue;
+		QByteArray there;   // name1;name2;...
+		foreach(const QByteArray& recipient, recipients)
+			if(it->projects.contains(QString::fromUtf8(recipient)))
+			{
+				if(!there.isEmpty())
+					there.append(Connection::Delimiter2);
+				there.append(recipient);
+			}
+		if(!there.isEmpty())
+			send(socket, "DELIVER", there + Connection::Delimiter1 + source.toUtf8() + Connection::Delimiter1 + packet);
+	}
+}
+
+bool Cluster::isOnline(const QString& user) const
+{
+	for(QHash<QString, Node>::ConstIterator it = nodes.begin(); it != nodes.end(); ++it)
+		if(it->projects.contains(user))
+			return true;
+	return false;
+}
+
+QStringList Cluster::getMembers(const QString& project) const
+{
+	QStringList result;
+	for(QHash<QString, Node>::ConstIterator it = nodes.begin(); it != nodes.end(); ++it)
+		if(it->counts.value(project) > 0)
+			for(QHash<QString, QString>::ConstIterator user = it->projects.begin(); user != it->projects.end(); ++user)
+				if(user.value() == project)
+					result << user.key();
+	return result;
+}
+
+// a peer too slow to keep up is dropped, and synced again when relinked
+// not here: aborting drops the node, which the callers may be iterating over
+void Cluster::send(QTcpSocket* socket, const QByteArray& header, const QByteArray& body)
+{
+	if(behind.contains(socket))
+		return;
+	if(socket->bytesToWrite() > MaxBacklog)
+	{
+		qDebug() << "Dropping the link to node" << links.value(socket)->node << ", too far behind";
+		behind << socket;
+		if(behind.size() == 1)
+			QTimer::singleShot(0, this, SLOT(onDropBehind()));
+		return;
+	}
+	socket->write(Sender::makePacket(header, body));
+	++numRelayed;
+}
+
+void Cluster::onDropBehind()
+{
+	QList<QTcpSocket*> sockets = behind;
+	behind.clear();
+	foreach(QTcpSocket* socket, sockets)
+		if(links.contains(socket))
+			socket->abort();
+}
+
+void Cluster::sendToAll(const QByteArray& header, const QByteArray& body)
+{
+	foreach(QTcpSocket* socket, outbound)
+		if(socket->state() == QAbstractSocket::ConnectedState)
+			send(socket, header, body);
+}
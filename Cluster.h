@@ -0,0 +1,129 @@
+#ifndef Cluster_h__
+#define Cluster_h__
+
+#include <QObject>
+#include <QTcpServer>
+#include <QTimer>
+#include <QHash>
+#include <QMap>
+#include <QStringList>
+#include <QElapsedTimer>
+#include "TeamRadarEvent.h"
+
+class QTcpSocket;
+
+// Several server processes (nodes) sharing the projects, each owning a subset of the clients
+// Every node links to each of its peers, and sends on that link only; it receives on the links from them
+// so two nodes are joined by two TCP connections, and neither has to be chosen
+// The users of a peer go with either of its links; losing the link to it closes the one from it too,
+// so the peer relinks and tells them again. Both send BEAT, so a crashed or partitioned peer
+// is noticed after 3 silent heartbeats
+// A node tells its peers which of its online users are in which project, and sends the events
+// and group packets of a project only to the peers with members of it
+// Format of packet: header#size#body, as of the clients
+//   NODE:    node name, the first packet on a link, in both directions
+//   BEAT:    empty, every heartbeat on every link, in both directions
+//   JOIN:    project#user, the user is online on the sender, in the project (empty for none)
+//   LEAVE:   user, offline on the sender
+//   EVENT:   project#event body, see TeamRadarEvent::getBody()
+//   GROUP:   project#source user#packet, to the members of the project but the source, e.g., PHOTO_REPLY
+//   DELIVER: recipients#source user#packet, to the recipients on the receiver, e.g., CHAT
+//            recipients = name1;name2;...
+class Cluster : public QObject
+{
+	Q_OBJECT
+
+	struct Link   // to or from a peer
+	{
+		Link() : socket(0), lastReceived(0) {}
+		QTcpSocket* socket;
+		QString     address;        // host:port of an outbound link, empty for an inbound one
+		QString     node;           // from its NODE, empty until then
+		QByteArray  buffer;         // received, not framed yet
+		qint64      lastReceived;   // msecs, of clock
+	};
+
+	struct Node   // a peer, as told on its link to this node
+	{
+		Node() : link(0) {}
+		QTcpSocket*             link;       // inbound, the latest from the peer
+		QHash<QString, QString> projects;   // online user -> project
+		QHash<QString, int>     counts;     // project -> number of online users
+	};
+
+public:
+	Cluster(QObject* parent = 0);
+	~Cluster();
+
+	void setName(const QString& name) { nodeName = name; }
+	QString getName() const { return nodeName; }
+	bool listen(quint16 port);                      // for the links from the peers, 0 for no cluster
+	void setPeers(const QStringList& addresses);    // host:port, linked and relinked when lost
+	bool isEnabled() const { return server.isListening() || !peers.isEmpty(); }
+	void setHeartbeatInterval(int msecs);           // links silent for 3 intervals are dropped
+
+	// the users of this node, to the peers
+	void join (const QString& user, const QString& project);
+	void leave(const QString& user);
+
+	// to the peers with members of the project, or with the recipients online
+	void relayEvent(const QString& project, const TeamRadarEvent& event);
+	void relayGroup(const QString& project, const QString& source, const QByteArray& packet);
+	void deliver(const QList<QByteArray>& recipients, const QString& source, const QByteArray& packet);
+
+	// the users online on the peers
+	bool        isOnline(const QString& user) const;
+	QStringList getMembers(const QString& project) const;
+
+	int    getNumPeers() const { return routes.size(); }   // linked both ways
+	qint64 getNumRelayed() const { return numRelayed; }    // packets sent to peers
+	qint64 getNumSkipped() const { return numSkipped; }    // not sent, no members on the peer
+
+signals:
+	void eventReceived(const QString& project, const TeamRadarEvent& event);
+	void groupReceived(const QString& project, const QString& source, const QByteArray& packet);
+	void deliverReceived(const QList<QByteArray>& recipients, const QString& source, const QByteArray& packet);
+
+private slots:
+	void onNewLink();        // inbound
+	void onConnected();      // outbound
+	void onReadyRead();
+	void onDisconnected();
+	void onRelink();
+	void onHeartbeat();
+	void onDropBehind();
+
+private:
+	void addLink(QTcpSocket* socket, const QString& address);
+	void dropNode(const QString& name);   // and its inbound link
+	void process(Link* link, const QByteArray& header, const QByteArray& body);
+	void join (Node& node, const QString& user, const QString& project);
+	void leave(Node& node, const QString& user);
+	void send(QTcpSocket* socket, const QByteArray& header, const QByteArray& body);
+	void sendToAll(const QByteArray& header, const QByteArray& body);   // on all outbound links
+
+public:
+	static const int MaxPacketSize = 8 * 1024 * 1024;   // a photo, wrapped
+	static const int MaxBacklog    = 32 * 1024 * 1024;  // unsent to a peer, before the link is dropped and synced again
+	static const int RelinkInterval = 5 * 1000;
+	static const int HeartbeatInterval = 5 * 1000;
+
+private:
+	QString     nodeName;
+	QTcpServer  server;
+	QStringList peers;                           // host:port
+	QHash<QTcpSocket*, Link*>    links;          // both directions
+	QMap<QString, QTcpSocket*>   outbound;       // host:port -> link, connected or connecting
+	QHash<QString, QTcpSocket*>  routes;         // node -> outbound link, after its NODE
+	QHash<QString, Node>         nodes;          // node -> its users, by its inbound link
+	QHash<QString, QString>      locals;         // online user of this node -> project
+	QTimer      relinkTimer;
+	QTimer      heartbeatTimer;
+	QList<QTcpSocket*> behind;                   // too slow, dropped once the senders have returned
+	QElapsedTimer clock;
+	int         linkTimeout;                     // msecs
+	qint64      numRelayed;
+	qint64      numSkipped;
+};
+
+#endif // Cluster_h__
@@ -0,0 +1,49 @@
+#ifndef CommandHandler_h__
+#define CommandHandler_h__
+
+#include <QStringList>
+#include <QDateTime>
+#include <QByteArray>
+
+class Connection;
+
+// Handles the messages of the clients, called directly by Receiver after parsing
+// source is the connection the message came from
+// One handler serves all the connections of a Server, so nothing is wired per connection
+// Format of the messages see Receiver::DataType, the default handlers ignore them
+class CommandHandler
+{
+public:
+	virtual ~CommandHandler() {}
+
+	// life cycle of the connection
+	virtual void onReadyForUse (Connection*) {}   // greeted
+	virtual void onDisconnected(Connection*) {}
+	virtual void onChangeName  (Connection*, const QString& /*oldName*/, const QString& /*newName*/) {}
+
+	// messages
+	virtual void onNewEvent   (Connection*, const QByteArray& /*message*/) {}
+	virtual void onRegPhoto   (Connection*, const QByteArray& /*photoData*/) {}
+	virtual void onRegColor   (Connection*, const QByteArray& /*color*/) {}
+	virtual void onChat       (Connection*, const QList<QByteArray>& /*recipients*/, const QByteArray& /*content*/) {}
+	virtual void onJoinProject(Connection*, const QString& /*projectName*/) {}
+	virtual void onReqTeamMembers(Connection*) {}
+	virtual void onReqTimeSpan   (Connection*) {}
+	virtual void onReqProjects   (Connection*) {}
+	virtual void onReqSnapshot   (Connection*) {}
+	virtual void onReqOnline  (Connection*, const QString& /*targetUser*/) {}
+	virtual void onReqPhoto   (Connection*, const QString& /*targetUser*/) {}
+	virtual void onReqColor   (Connection*, const QString& /*targetUser*/) {}
+	virtual void onReqLocation(Connection*, const QString& /*targetUser*/) {}
+	virtual void onReqBatch   (Connection*, const QList<QByteArray>& /*requests*/) {}
+	virtual void onReqEvents  (Connection*, const QStringList& /*users*/, const QStringList& /*eventTypes*/,
+							   const QDateTime& /*startTime*/, const QDateTime& /*endTime*/,
+							   const QStringList& /*phases*/, int /*fuzziness*/,
+							   int /*pageSize*/, const QByteArray& /*token*/) {}
+	virtual void onReqActivity(Connection*, const QDateTime& /*startTime*/, const QDateTime& /*endTime*/,
+							   const QString& /*resolution*/,
+							   const QStringList& /*users*/, const QStringList& /*eventTypes*/) {}
+	virtual void onReqFileActivity(Connection*, const QString& /*prefix*/, int /*maxResults*/) {}
+};
+
+#endif // CommandHandler_h__
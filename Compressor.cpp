@@ -0,0 +1,127 @@
+#include "Compressor.h"
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#include <string.h>
+
+int    Compressor::compressionLevel = 1;   // Z_BEST_SPEED: most of the gain is from the repetition
+qint64 Compressor::numBytesIn  = 0;
+qint64 Compressor::numBytesOut = 0;
+
+namespace {
+
+// header -> the smallest packet compressed
+// bulk replies are repetitive, and worth it from small sizes, as the context is shared
+// live traffic is compressed only when large, so a tiny EVENT is not delayed for a few bytes
+struct Threshold
+{
+	const char* header;
+	int         size;
+};
+
+const Threshold thresholds[] = {
+	{"EVENTS_REPLY",        64},
+	{"EVENTS_PAGE_END",     64},
+	{"ACTIVITY_REPLY",      64},
+	{"FILE_ACTIVITY_REPLY", 64},
+	{"TEAM_SNAPSHOT",       64},
+	{"TEAMMEMBERS_REPLY",   64},
+	{"PROJECTS_REPLY",      64},
+	{"PHOTO_REPLY",         1024},
+	{"EVENT",               512},
+	{"CHAT",                512}
+};
+
+}
+
+Compressor::Compressor() : stream(0) {}
+
+#ifdef HAVE_ZLIB
+
+bool Compressor::isAvailable()
+{
+	return true;
+}
+
+Compressor::~Compressor()
+{
+	if(stream != 0)
+	{
+		deflateEnd(stream);
+		delete stream;
+	}
+}
+
+bool Compressor::start()
+{
+	stream = new z_stream;
+	memset(stream, 0, sizeof(z_stream));
+	if(deflateInit2(stream, compressionLevel, Z_DEFLATED, WindowBits, MemLevel, Z_DEFAULT_STRATEGY) == Z_OK)
+		return true;
+	delete stream;
+	stream = 0;
+	return false;
+}
+
+QByteArray Compressor::compress(const QByteArray& data)
+{
+	if(stream == 0 && !start())
+		return QByteArray();
+
+	QByteArray result;
+	result.resize(deflateBound(stream, data.size()) + 16);   // + the sync flush marker
+	stream->next_in   = reinterpret_cast<Bytef*>(const_cast<char*>(data.constData()));
+	stream->avail_in  = data.size();
+	stream->next_out  = reinterpret_cast<Bytef*>(result.data());
+	stream->avail_out = result.size();
+	if(deflate(stream, Z_SYNC_FLUSH) != Z_OK || stream->avail_in != 0)
+		return QByteArray();
+
+	result.resize(result.size() - stream->avail_out);
+	numBytesIn  += data.size();
+	numBytesOut += result.size();
+	return result;
+}
+
+// as documented in zconf.h, plus the stream itself
+int Compressor::getMemoryUsage() const
+{
+	if(stream == 0)
+		return 0;
+	return sizeof(z_stream) + (1 << (WindowBits + 2)) + (1 << (MemLevel + 9));
+}
+
+#else
+
+// never offered at GREETING, so none of these is called on a live connection
+bool Compressor::isAvailable()
+{
+	return false;
+}
+
+Compressor::~Compressor() {}
+
+bool Compressor::start()
+{
+	return false;
+}
+
+QByteArray Compressor::compress(const QByteArray&)
+{
+	return QByteArray();
+}
+
+int Compressor::getMemoryUsage() const
+{
+	return 0;
+}
+
+#endif
+
+int Compressor::getThreshold(const char* header, int size)
+{
+	for(int i = 0; i < int(sizeof(thresholds) / sizeof(thresholds[0])); ++i)
+		if(int(qstrlen(thresholds[i].header)) == size && qstrncmp(thresholds[i].header, header, size) == 0)
+			return thresholds[i].size;
+	return -1;
+}
@@ -0,0 +1,49 @@
+#ifndef Compressor_h__
+#define Compressor_h__
+
+#include <QByteArray>
+
+struct z_stream_s;
+
+// The outbound deflate stream of a connection, negotiated at GREETING
+// Its context persists across packets, so the names, types and paths repeated in the replies
+// cost a few bytes after their first time
+// Each packet is flushed (Z_SYNC_FLUSH), so the client can inflate it as soon as it arrives
+// Format of packet: Z#size#deflated packets, see Sender::send()
+class Compressor
+{
+public:
+	Compressor();
+	~Compressor();
+
+	QByteArray compress(const QByteArray& data);   // empty if failed
+	bool isStarted() const { return stream != 0; }
+	int  getMemoryUsage() const;   // of the zlib state, 0 until the first packet
+
+	// the smallest packet worth compressing, by header; -1 for never
+	static int getThreshold(const char* header, int size);
+	static void setLevel(int level) { compressionLevel = level; }   // 0 for not offering it
+	static bool isEnabled() { return isAvailable() && compressionLevel > 0; }
+	static bool isAvailable();   // built with zlib (HAVE_ZLIB)
+
+	// statistics of all connections
+	static qint64 getNumBytesIn()  { return numBytesIn;  }
+	static qint64 getNumBytesOut() { return numBytesOut; }
+
+private:
+	Compressor(const Compressor&);
+	Compressor& operator=(const Compressor&);
+	bool start();
+
+private:
+	z_stream_s* stream;   // created on the first packet
+
+	static const int WindowBits = 12;   // 4KB of history, about 32KB of state with MemLevel
+	static const int MemLevel   = 5;
+
+	static int    compressionLevel;
+	static qint64 numBytesIn;
+	static qint64 numBytesOut;
+};
+
+#endif // Compressor_h__
@@ -1,164 +1,332 @@
 #include "Connection.h"
 #include "MainWnd.h"
 #include "TeamRadarEvent.h"
-#include <QHostAddress>
-#include <QTimerEvent>
+#include "PacketRecorder.h"
+#include "Tracer.h"
+#include "Fields.h"
+#include "LoadMonitor.h"
+#include "Scheduler.h"
+#include "BufferPool.h"
+#include <QTcpSocket>
+#include <QLocalSocket>
 #include <QColor>
 
-Connection::Connection(QObject *parent) : QTcpSocket(parent)
+Connection::Connection(QIODevice* s, CommandHandler* h, QObject *parent)
+	: QObject(parent), socket(s), receiver(this), sender(this), outbox(this), handler(h)
 {
+	id = nextID++;
 	ready = false;
+	closed = false;
 	dataType = Receiver::Undefined;
 	numBytes = -1;
-	transferTimerID = 0;
+	tokenSize = 0;
+	numBytesRead = 0;
+	numBytesRecorded = 0;
+	resumeSequence = -1;
+	scheduler = 0;
+	wheel = 0;
+	compressor = 0;
+	keepAlive = false;
+	pingSent = false;
+	transferTimer.init(this, &Connection::onTransferTimeout);
+	idleTimer    .init(this, &Connection::onIdle);
 	userName = tr("Unknown");
-	receiver = new Receiver(this);
-	sender   = new Sender  (this);
+	userNameUtf8 = userName.toUtf8();
 
-	connect(this, SIGNAL(readyRead()),    this, SLOT(onReadyRead()));
-	connect(this, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
+	socket->setParent(this);
+	connect(socket, SIGNAL(readyRead()),         this, SLOT(onReadyRead()));
+	connect(socket, SIGNAL(bytesWritten(qint64)), this, SLOT(onBytesWritten()));
+	if(QAbstractSocket* tcpSocket = qobject_cast<QAbstractSocket*>(socket))
+	{
+		tcpSocket->setSocketOption(QAbstractSocket::KeepAliveOption, 1);   // for the clients without PING
+		tcpSocket->setReadBufferSize(ReadBufferSize);
+		connect(socket, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
+		connect(socket, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(onDisconnected()));
+	}
+	else if(QLocalSocket* localSocket = qobject_cast<QLocalSocket*>(socket))
+	{
+		localSocket->setReadBufferSize(ReadBufferSize);
+		connect(socket, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
+		connect(socket, SIGNAL(error(QLocalSocket::LocalSocketError)), this, SLOT(onDisconnected()));
+	}   // other devices, e.g., a QBuffer in tests, do not disconnect
+}
+
+void Connection::abort()
+{
+	if(QAbstractSocket* tcpSocket = qobject_cast<QAbstractSocket*>(socket))
+		tcpSocket->abort();
+	else if(QLocalSocket* localSocket = qobject_cast<QLocalSocket*>(socket))
+		localSocket->abort();
+}
+
+Connection::~Connection() {
+	delete compressor;
+}
+
+void Connection::setCompression(bool enable)
+{
+	delete compressor;
+	compressor = enable ? new Compressor : 0;
+}
+
+// without waiting for the socket to report it, which a half-open one may never do
+void Connection::drop()
+{
+	abort();
+	onDisconnected();
+}
+
+// not its own events, and only the subscribed ones
+bool Connection::accepts(const QString& source, int typeBit, const QString& eventType) {
+	return source != userName && subscription.accepts(typeBit, eventType, source);
 }
 
 void Connection::setUserName(const QString& name)
 {
 	if(name != userName && !name.isEmpty())
 	{
-		emit changeName(userName, name);
+		if(ready && handler != 0)   // renamed after GREETING
+			handler->onChangeName(this, userName, name);
 		userName = name;
+		userNameUtf8 = name.toUtf8();
 	}
 }
 
-// transfer time out
-void Connection::timerEvent(QTimerEvent* timerEvent)
+// the idle deadline of a keepalive client starts now
+void Connection::setTimerWheel(TimerWheel* w)
 {
-	if(timerEvent->timerId() == transferTimerID)  // the event is for this connection
+	wheel = w;
+	if(keepAlive && wheel != 0)
+		wheel->start(&idleTimer, keepAliveInterval);
+}
+
+// a frame has been partly received for too long
+void Connection::onTransferTimeout() {
+	abort();
+}
+
+// nothing received for an interval: ping, then reap if still silent
+void Connection::onIdle()
+{
+	if(!pingSent)
 	{
-		abort();
-		killTimer(transferTimerID);
-		transferTimerID = 0;
+		pingSent = true;
+		write(Sender::makePacket("PING"));
+		wheel->start(&idleTimer, keepAliveTimeout);
+	}
+	else
+	{
+		qDebug() << "Reaping silent connection" << id << userName;
+		drop();
 	}
 }
 
+// a client that sends PING is known to answer one
+void Connection::setKeepAlive()
+{
+	keepAlive = keepAliveInterval > 0;
+	if(keepAlive && wheel != 0)
+		wheel->start(&idleTimer, keepAliveInterval);
+}
+
+void Connection::setKeepAliveTimes(int interval, int timeout)
+{
+	keepAliveInterval = interval;
+	keepAliveTimeout  = timeout;
+}
+
 // new data incoming
 void Connection::onReadyRead()
 {
-	do {
-		if(dataType == Receiver::Undefined && !readHeader())  // read header
-			return;
-		if(!hasEnoughData())                                  // read length, and wait for data
-			return;
-		processData();
-	} while(bytesAvailable() > 0);
+	pingSent = false;   // any traffic proves it alive
+	if(keepAlive && wheel != 0)
+		wheel->start(&idleTimer, keepAliveInterval);
+
+	if(PacketRecorder::isRecording())
+		record();
+
+	readPackets();
+	numBytesRecorded = socket->bytesAvailable();   // left for the next round
 }
 
-// read data type
-bool Connection::readHeader()
+// only the bytes that arrived after the last round are recorded
+void Connection::record()
 {
-	if(transferTimerID)   // reset timer
-	{
-		killTimer(transferTimerID);
-		transferTimerID = 0;
-	}
+	qint64 available = socket->bytesAvailable();
+	if(available > numBytesRecorded)
+		PacketRecorder::recordData(id, socket->peek(available).mid(numBytesRecorded));
+}
 
-	if(readDataIntoBuffer() <= 0)         // read header data
+void Connection::readPackets()
+{
+	frame();
+	if(scheduler != 0)
+		scheduler->schedule(this);
+	else
+		while(processPackets(MaxQueuedPackets, true) > 0) {}
+}
+
+void Connection::frame()
+{
+	TraceSpan span("Connection::frame", id);
+	while(packets.size() < MaxQueuedPackets && !closed)
 	{
-		transferTimerID = startTimer(TransferTimeout);
-		return false;
+		if(dataType == Receiver::Undefined && !readHeader())  // read header
+			break;
+		if(!hasEnoughData())                                  // read length, and wait for data
+			break;
+		readData();
 	}
+	numBytesRecorded = qMin(numBytesRecorded, socket->bytesAvailable());   // all left were recorded
+
+	if(wheel == 0)
+		return;
+	if(dataType != Receiver::Undefined || tokenSize > 0)   // in the middle of a frame
+		wheel->start(&transferTimer, TransferTimeout);
+	else
+		wheel->stop(&transferTimer);
+}
 
-	dataType = receiver->guessDataType(buffer);    // read header type
-	buffer.clear();
+bool Connection::isNextBulk() const {
+	return !packets.isEmpty() && Receiver::isBulk(packets.head().dataType);
+}
 
-	if(dataType == Receiver::Undefined)   // ignore unknown
+int Connection::processPackets(int max, bool bulk)
+{
+	int count = 0;
+	for(; count < max && !packets.isEmpty() && !closed; ++count)
 	{
-		qDebug() << "Unknown dataType: " << buffer;
-		return false;
+		if(!bulk && isNextBulk())
+			break;
+		Packet packet = packets.dequeue();
+		TraceSpan span("Receiver::processData", id, Receiver::getHeader(packet.dataType));
+		receiver.processData(packet.dataType, packet.body);
+		BufferPool::release(packet.body);
 	}
-
-	return true;
+	if(packets.isEmpty())
+		packets.clear();   // frees its array while idle
+	if(packets.size() < MaxQueuedPackets && socket->bytesAvailable() > 0)
+		frame();   // the rest in the socket
+	return count;
 }
 
-// read until '#' into buffer, return the number of bytes read
-int Connection::readDataIntoBuffer(int maxSize)
+// read data type
+bool Connection::readHeader()
 {
-	if (maxSize > MaxBufferSize)
-		return 0;
+	if(!readToken())                      // read header data
+		return false;
 
-	int numBytesBeforeRead = buffer.size();
-	if(numBytesBeforeRead == MaxBufferSize)  // buffer full
-	{
-		abort();
-		return 0;
-	}
+	dataType = Receiver::findDataType(token, tokenSize);    // read header type
+	if(dataType == Receiver::Undefined)   // ignore unknown
+		qDebug() << "Unknown dataType: " << QByteArray(token, tokenSize);
+	tokenSize = 0;
+	return dataType != Receiver::Undefined;
+}
 
-	// read until separator
-	while(bytesAvailable() > 0 && buffer.size() < maxSize)
+// read until '#' into token, true if the whole token has arrived
+// reads byte by byte, so that the body is left in the socket for one read
+bool Connection::readToken()
+{
+	char c;
+	while(socket->getChar(&c))
 	{
-		buffer.append(read(1));
-		if(buffer.endsWith(Delimiter1))
-			break;
+		if(c == Delimiter1)
+			return true;
+		if(tokenSize == MaxTokenSize)   // neither a header nor a size
+		{
+			abort();
+			return false;
+		}
+		token[tokenSize++] = c;
 	}
-
-	return buffer.size() - numBytesBeforeRead;
+	return false;
 }
 
 int Connection::getDataLength()
 {
-	if(bytesAvailable() <= 0 || readDataIntoBuffer() <= 0 || !buffer.endsWith(Delimiter1))
-		return 0;
+	if(!readToken())
+		return -1;
 
-	buffer.chop(1);    // chop delimiter
-	int number = buffer.toInt();
-	buffer.clear();
+	bool ok;
+	int number = Field(token, tokenSize).toInt(&ok);
+	tokenSize = 0;
+	if(!ok || number < 0 || number > MaxBufferSize)   // not a size: the frames are lost
+	{
+		abort();
+		return -1;
+	}
 	return number;
 }
 
-// wait for the data
+// read the body into a pooled buffer as it arrives, so that the socket buffers only a little
 bool Connection::hasEnoughData()
 {
-	if(transferTimerID)   // reset timer
-	{
-		QObject::killTimer(transferTimerID);
-		transferTimerID = 0;
-	}
-
 	if(numBytes < 0)	  // get length
-		numBytes = getDataLength();
-
-	if(bytesAvailable() < numBytes)	// start timer and wait for data
 	{
-		transferTimerID = startTimer(TransferTimeout);
-		return false;
+		numBytes = getDataLength();
+		if(numBytes < 0)
+			return false;
+		body = BufferPool::acquire(numBytes);
+		numBytesRead = 0;
 	}
-
-	return true;
+	if(numBytesRead < numBytes)
+		numBytesRead += qMax(socket->read(body.data() + numBytesRead, numBytes - numBytesRead), qint64(0));
+	return numBytesRead == numBytes;   // or wait for data
 }
 
-// parse
-void Connection::processData()
+// queue the body
+void Connection::readData()
 {
-	buffer = read(numBytes);
-	if(buffer.size() != numBytes)
-		return abort();
-
-	receiver->processData(dataType, buffer);
-
+	Packet packet;
+	packet.dataType = dataType;
+	packet.body     = body;
+	body = QByteArray();   // the packet holds the only reference, for the pool
+	packets.enqueue(packet);
 	dataType = Receiver::Undefined;   // reset status
 	numBytes = -1;
-	buffer.clear();
+}
+
+void Connection::onBytesWritten() {
+	outbox.pump();
 }
 
 void Connection::onDisconnected()
 {
+	if(closed)   // an error may be followed by disconnected()
+		return;
+	closed = true;
+	outbox.clear();
+	if(wheel != 0)
+	{
+		wheel->stop(&transferTimer);
+		wheel->stop(&idleTimer);
+	}
+	PacketRecorder::recordClose(id);
 	userNames.remove(userName);
 	ready = false;
+	if(handler != 0)
+		handler->onDisconnected(this);
 }
 
 void Connection::setReadyForUse()
 {
 	userNames.insert(userName);  // add itself to online name list
 	ready = true;
-	emit readyForUse();
+	if(handler != 0)
+		handler->onReadyForUse(this);
+}
+
+MemoryUsage Connection::getMemoryUsage() const
+{
+	MemoryUsage usage;
+	usage.buffers = body.capacity() + socket->bytesAvailable();
+	foreach(const Packet& packet, packets)
+		usage.buffers += packet.body.capacity();
+	usage.output  = socket->bytesToWrite() + outbox.getNumBytesQueued();
+	usage.objects = sizeof(Connection) + SocketOverhead + packets.size() * sizeof(Packet) +
+					userName.capacity() * sizeof(QChar) + userNameUtf8.capacity() +
+					(compressor != 0 ? sizeof(Compressor) + compressor->getMemoryUsage() : 0);
+	return usage;
 }
 
 bool Connection::userExists(const QString& userName) {
@@ -166,6 +334,9 @@ bool Connection::userExists(const QString& userName) {
 }
 
 QSet<QString> Connection::userNames;
+quint32       Connection::nextID = 1;
+int           Connection::keepAliveInterval = 60 * 1000;
+int           Connection::keepAliveTimeout  = 30 * 1000;
 
 
 //////////////////////////////////////////////////////////////////////////
@@ -178,22 +349,99 @@ Sender* Receiver::getSender() const {
 QString Receiver::getUserName() const {
 	return connection->getUserName();
 }
+CommandHandler* Receiver::getHandler() const {
+	return connection != 0 ? connection->getHandler() : 0;
+}
+
+Receiver::DataType Receiver::guessDataType(const QByteArray& header)
+{
+	int size = header.endsWith(Connection::Delimiter1) ? header.size() - 1 : header.size();
+	return findDataType(header.constData(), size);
+}
+
+Receiver::DataType Receiver::findDataType(const char* header, int size)
+{
+	const HeaderEntry* entry = hashTable[hash(header, size)];
+	return entry != 0 && Field(header, size) == entry->header ? entry->dataType : Undefined;
+}
+
+// FNV-1a
+uint Receiver::hash(const char* header, int size)
+{
+	uint result = HashSeed;
+	for(int i = 0; i < size; ++i)
+		result = (result ^ uchar(header[i])) * 16777619u;
+	return result & (HashSize - 1);
+}
 
-Receiver::DataType Receiver::guessDataType(const QByteArray& h)
+bool Receiver::isBulk(DataType dataType)
 {
-	QByteArray header = h;
-	if(header.endsWith('#'))
-		header.chop(1);
-	return dataTypes.contains(header) ? dataTypes[header] : Undefined;
+	return dataType > Undefined && dataType < NumDataTypes &&
+		   (classes[dataType] == RateLimiter::History || classes[dataType] == RateLimiter::Photos);
+}
+
+QByteArray Receiver::getHeader(DataType dataType) {
+	return dataType > Undefined && dataType < NumDataTypes ? headers[dataType] : QByteArray();
 }
 
-void Receiver::processData(Receiver::DataType dataType, const QByteArray& buffer) {
-	if(dataType != Undefined)
-		(this->*parsers[dataType])(buffer);   // call specific parser
+void Receiver::processData(Receiver::DataType dataType, const QByteArray& buffer)
+{
+	if(dataType <= Undefined || dataType >= NumDataTypes)
+		return;
+	if(connection != 0 && !connection->isReadyForUse() &&
+	   dataType != Greeting && dataType != Ping && dataType != Pong)   // nothing else before GREETING
+	{
+		qDebug() << "Ignored before GREETING:" << headers[dataType] << "from connection" << connection->getID();
+		return;
+	}
+	if(connection != 0 && !admit(dataType))
+		return;
+	(this->*parsers[dataType])(buffer);   // call specific parser
+}
+
+// the rate limits of the connection, and shedding of the expensive requests under overload
+// the live events are never shed, only limited
+bool Receiver::admit(DataType dataType)
+{
+	RateLimiter::MessageClass messageClass = classes[dataType];
+	bool expensive = isBulk(dataType);
+	if(expensive && LoadMonitor::isOverloaded())
+	{
+		LoadMonitor::countShed();
+		getSender()->send(Sender::makeBusyReply(headers[dataType], "OVERLOADED"));
+		return false;
+	}
+
+	RateLimiter& limiter = connection->getLimiter();
+	if(limiter.acquire(messageClass))
+		return true;
+
+	// a request waits for its reply, so each one is answered; a flood of events is told once
+	if(expensive || limiter.isNewlyThrottled(messageClass))
+		getSender()->send(Sender::makeBusyReply(headers[dataType], "RATE_LIMITED"));
+	return false;
 }
 
-void Receiver::parseGreeting(const QByteArray& userName)
+void Receiver::parseGreeting(const QByteArray& buffer)
 {
+	Fields sections(buffer, Connection::Delimiter1);
+	QByteArray userName = sections[0].toByteArray();
+	if(sections.size() > 1 && !sections[1].isEmpty())
+		connection->setResumeSequence(sections[1].toLongLong());
+
+	QStringList options = sections.size() > 2 ? sections[2].split(Connection::Delimiter2) : QStringList();
+	QByteArray accepted;   // #option1;option2
+	if(Compressor::isEnabled() && options.contains("DEFLATE"))
+	{
+		connection->setCompression(true);
+		accepted.append(Connection::Delimiter1).append("DEFLATE");
+	}
+	if(Outbox::isEnabled() && options.contains("CHUNKED"))
+	{
+		connection->getOutbox()->setChunked(true);
+		accepted.append(accepted.isEmpty() ? Connection::Delimiter1 : Connection::Delimiter2).append("CHUNKED");
+	}
+
 	connection->setUserName(userName);
 	if(userName.isEmpty() || connection->userExists(userName))  // check user name
 	{
@@ -202,7 +450,7 @@ void Receiver::parseGreeting(const QByteArray& userName)
 	}
 	else
 	{
-		connection->write(Sender::makePacket("GREETING", "OK, CONNECTED"));
+		connection->write(Sender::makePacket("GREETING", "OK, CONNECTED" + accepted));
 		connection->setReadyForUse();
 	}
 }
@@ -215,105 +463,182 @@ void Receiver::parseChangeName(const QByteArray& newName) {
 // offline events request
 void Receiver::parseReqEvents(const QByteArray& buffer)
 {
-	QList<QByteArray> sections = buffer.split(Connection::Delimiter1);
-	if(sections.size() != 5)
+	Fields sections(buffer, Connection::Delimiter1);
+	Fields span(sections[2], Connection::Delimiter2);
+	if(sections.size() < 5 || sections.size() > 7 || span.size() < 2)
 		return;
 
-	QStringList users  = QString(sections[0]).split(Connection::Delimiter2);
-	QStringList events = QString(sections[1]).split(Connection::Delimiter2);
-	QString startTime  = sections[2].split(Connection::Delimiter2).at(0);
-	QString endTime    = sections[2].split(Connection::Delimiter2).at(1);
-	QStringList phases = QString(sections[3]).split(Connection::Delimiter2);
+	QStringList users  = sections[0].split(Connection::Delimiter2);
+	QStringList events = sections[1].split(Connection::Delimiter2);
+	QStringList phases = sections[3].split(Connection::Delimiter2, true);   // none: the db pages
 	int fuzziness      = sections[4].toInt();
-	emit reqEvents(users, events, QDateTime::fromString(startTime, MainWnd::dateTimeFormat),
-								  QDateTime::fromString(endTime,   MainWnd::dateTimeFormat),
-				   phases, fuzziness);
+	int pageSize       = sections.size() > 5 ? sections[5].toInt() : -1;   // -1: not paged
+	QByteArray token   = sections.size() > 6 ? sections[6].toByteArray() : QByteArray();
+	if(CommandHandler* handler = getHandler())
+		handler->onReqEvents(connection, users, events,
+							 span[0].toDateTime(MainWnd::dateTimeFormat),
+							 span[1].toDateTime(MainWnd::dateTimeFormat),
+							 phases, fuzziness, pageSize, token);
+}
+
+void Receiver::parseReqActivity(const QByteArray& buffer)
+{
+	Fields sections(buffer, Connection::Delimiter1);
+	if(sections.size() != 4)
+		return;
+
+	Fields span(sections[0], Connection::Delimiter2);
+	if(span.size() != 2)
+		return;
+	QString resolution = sections[1] == "DAY" ? "DAY" : "HOUR";
+	QStringList users  = sections[2].split(Connection::Delimiter2, true);
+	QStringList events = sections[3].split(Connection::Delimiter2, true);
+	if(CommandHandler* handler = getHandler())
+		handler->onReqActivity(connection,
+							   span[0].toDateTime(MainWnd::dateTimeFormat),
+							   span[1].toDateTime(MainWnd::dateTimeFormat),
+							   resolution, users, events);
+}
+
+void Receiver::parseReqFileActivity(const QByteArray& buffer)
+{
+	Fields sections(buffer, Connection::Delimiter1);
+	CommandHandler* handler = getHandler();
+	if(handler != 0 && sections.size() == 2)
+		handler->onReqFileActivity(connection, sections[0].toString(), sections[1].toInt());
 }
 
 void Receiver::parseChat(const QByteArray& buffer)
 {
-	QList<QByteArray> sections = buffer.split(Connection::Delimiter1);
-	if(sections.size() == 2) {
-		QList<QByteArray> recipients = sections[0].split(Connection::Delimiter2);
-		emit chatMessage(recipients, sections[1]);
-	}
+	Fields sections(buffer, Connection::Delimiter1);
+	CommandHandler* handler = getHandler();
+	if(handler != 0 && sections.size() == 2)
+		handler->onChat(connection, sections[0].splitBytes(Connection::Delimiter2), sections[1].toByteArray());
 }
 
 void Receiver::parseEvent(const QByteArray& buffer) {
-	emit newEvent(connection->getUserName(), buffer);
+	if(CommandHandler* handler = getHandler())
+		handler->onNewEvent(connection, buffer);
 }
 void Receiver::parseRegPhoto(const QByteArray& buffer) {
-	emit regPhoto(connection->getUserName(), buffer);
+	if(CommandHandler* handler = getHandler())
+		handler->onRegPhoto(connection, buffer);
 }
 void Receiver::parseRegColor(const QByteArray& buffer) {
-	emit regColor(connection->getUserName(), buffer);
+	if(CommandHandler* handler = getHandler())
+		handler->onRegColor(connection, buffer);
 }
 void Receiver::parseReqOnline(const QByteArray& buffer) {
-	emit reqOnline(buffer);
+	if(CommandHandler* handler = getHandler())
+		handler->onReqOnline(connection, buffer);
 }
 void Receiver::parseReqPhoto(const QByteArray& buffer) {
-	emit reqPhoto(buffer);
+	if(CommandHandler* handler = getHandler())
+		handler->onReqPhoto(connection, buffer);
 }
 void Receiver::parseReqTeamMembers(const QByteArray&) {
-	emit reqTeamMembers();
+	if(CommandHandler* handler = getHandler())
+		handler->onReqTeamMembers(connection);
 }
 void Receiver::parseReqColor(const QByteArray& buffer) {
-	emit reqColor(buffer);
+	if(CommandHandler* handler = getHandler())
+		handler->onReqColor(connection, buffer);
 }
 void Receiver::parseReqTimeSpan(const QByteArray&) {
-	emit reqTimeSpan();
+	if(CommandHandler* handler = getHandler())
+		handler->onReqTimeSpan(connection);
 }
 void Receiver::parseReqProjects(const QByteArray&) {
-	emit reqProjects();
+	if(CommandHandler* handler = getHandler())
+		handler->onReqProjects(connection);
 }
 void Receiver::parseJoinProject(const QByteArray& buffer) {
-	emit joinProject(buffer);
+	if(CommandHandler* handler = getHandler())
+		handler->onJoinProject(connection, buffer);
 }
 void Receiver::parseReqLocation(const QByteArray& buffer) {
-	emit reqLocation(buffer);
+	if(CommandHandler* handler = getHandler())
+		handler->onReqLocation(connection, buffer);
+}
+void Receiver::parseReqSnapshot(const QByteArray&) {
+	if(CommandHandler* handler = getHandler())
+		handler->onReqSnapshot(connection);
+}
+// identical sub-requests are passed once, in the order they first appear
+void Receiver::parseReqBatch(const QByteArray& buffer)
+{
+	CommandHandler* handler = getHandler();
+	if(handler == 0)
+		return;
+	QList<QByteArray> requests;
+	QSet<QByteArray>  seen;
+	foreach(const QByteArray& request, buffer.split(Connection::Delimiter1))
+		if(!seen.contains(request))
+		{
+			seen << request;
+			requests << request;
+		}
+	handler->onReqBatch(connection, requests);
+}
+void Receiver::parseSubscribe(const QByteArray& buffer) {
+	connection->setSubscription(Subscription::parse(buffer));
 }
 
+void Receiver::parsePing(const QByteArray&)
+{
+	connection->setKeepAlive();
+	connection->write(Sender::makePacket("PONG"));
+}
+
+// the traffic has reset the idle deadline already
+void Receiver::parsePong(const QByteArray&) {}
+
+// header, data type, parser, rate limited class
+const Receiver::HeaderEntry Receiver::entries[] = {
+	{"GREETING",          Greeting,        &Receiver::parseGreeting,        RateLimiter::Unlimited},
+	{"CHANGE_NAME",       ChangeName,      &Receiver::parseChangeName,      RateLimiter::Unlimited},
+	{"EVENT",             Event,           &Receiver::parseEvent,           RateLimiter::Events},
+	{"CHAT",              Chat,            &Receiver::parseChat,            RateLimiter::Chat},
+
+	{"REG_PHOTO",         RegPhoto,        &Receiver::parseRegPhoto,        RateLimiter::Photos},
+	{"REG_COLOR",         RegColor,        &Receiver::parseRegColor,        RateLimiter::Unlimited},
+	{"JOIN_PROJECT",      JoinProject,     &Receiver::parseJoinProject,     RateLimiter::Unlimited},
+
+	{"REQ_ONLINE",        ReqOnline,       &Receiver::parseReqOnline,       RateLimiter::Unlimited},
+	{"REQ_PHOTO",         ReqPhoto,        &Receiver::parseReqPhoto,        RateLimiter::Photos},
+	{"REQ_COLOR",         ReqColor,        &Receiver::parseReqColor,        RateLimiter::Unlimited},
+	{"REQ_EVENTS",        ReqEvents,       &Receiver::parseReqEvents,       RateLimiter::History},
+	{"REQ_TIMESPAN",      ReqTimeSpan,     &Receiver::parseReqTimeSpan,     RateLimiter::History},
+	{"REQ_PROJECTS",      ReqProjects,     &Receiver::parseReqProjects,     RateLimiter::Unlimited},
+	{"REQ_TEAMMEMBERS",   ReqTeamMembers,  &Receiver::parseReqTeamMembers,  RateLimiter::Unlimited},
+	{"REQ_LOCATION",      ReqLocation,     &Receiver::parseReqLocation,     RateLimiter::Unlimited},
+	{"REQ_SNAPSHOT",      ReqSnapshot,     &Receiver::parseReqSnapshot,     RateLimiter::Unlimited},
+	{"REQ_BATCH",         ReqBatch,        &Receiver::parseReqBatch,        RateLimiter::Unlimited},
+	{"REQ_ACTIVITY",      ReqActivity,     &Receiver::parseReqActivity,     RateLimiter::History},
+	{"REQ_FILE_ACTIVITY", ReqFileActivity, &Receiver::parseReqFileActivity, RateLimiter::History},
+	{"SUBSCRIBE",         Subscribe,       &Receiver::parseSubscribe,       RateLimiter::Unlimited},
+	{"PING",              Ping,            &Receiver::parsePing,            RateLimiter::Unlimited},
+	{"PONG",              Pong,            &Receiver::parsePong,            RateLimiter::Unlimited}
+};
+
+const Receiver::HeaderEntry* Receiver::hashTable[HashSize];
+Receiver::Parser             Receiver::parsers[NumDataTypes];
+RateLimiter::MessageClass    Receiver::classes[NumDataTypes];
+QByteArray                   Receiver::headers[NumDataTypes];
+
 void Receiver::init()
 {
-	// header -> date type
-	dataTypes.insert("GREETING",    Greeting);
-	dataTypes.insert("CHANGE_NAME", ChangeName);
-	dataTypes.insert("EVENT",       Event);
-	dataTypes.insert("CHAT",        Chat);
-
-	dataTypes.insert("REG_PHOTO",    RegPhoto);
-	dataTypes.insert("REG_COLOR",    RegColor);
-	dataTypes.insert("JOIN_PROJECT", JoinProject);
-
-	dataTypes.insert("REQ_ONLINE",      ReqOnline);
-	dataTypes.insert("REQ_PHOTO",       ReqPhoto);
-	dataTypes.insert("REQ_COLOR",       ReqColor);
-	dataTypes.insert("REQ_EVENTS",      ReqEvents);
-	dataTypes.insert("REQ_TIMESPAN",    ReqTimeSpan);
-	dataTypes.insert("REQ_PROJECTS",    ReqProjects);
-	dataTypes.insert("REQ_TEAMMEMBERS", ReqTeamMembers);
-	dataTypes.insert("REQ_LOCATION",    ReqLocation);
-
-	// data type -> parser
-	parsers.insert(Greeting,       &Receiver::parseGreeting);
-	parsers.insert(ChangeName,     &Receiver::parseChangeName);
-	parsers.insert(Event,          &Receiver::parseEvent);
-	parsers.insert(Chat,           &Receiver::parseChat);
-	parsers.insert(ReqEvents,      &Receiver::parseReqEvents);
-	parsers.insert(JoinProject,    &Receiver::parseJoinProject);
-	parsers.insert(RegPhoto,       &Receiver::parseRegPhoto);
-	parsers.insert(RegColor,       &Receiver::parseRegColor);
-	parsers.insert(ReqTeamMembers, &Receiver::parseReqTeamMembers);
-	parsers.insert(ReqOnline,      &Receiver::parseReqOnline);
-	parsers.insert(ReqPhoto,       &Receiver::parseReqPhoto);
-	parsers.insert(ReqColor,       &Receiver::parseReqColor);
-	parsers.insert(ReqTimeSpan,    &Receiver::parseReqTimeSpan);
-	parsers.insert(ReqProjects,    &Receiver::parseReqProjects);
-	parsers.insert(ReqLocation,    &Receiver::parseReqLocation);
-}
-
-QMap<QString, Receiver::DataType>          Receiver::dataTypes;
-QMap<Receiver::DataType, Receiver::Parser> Receiver::parsers;
+	for(int i = 0; i < int(sizeof(entries) / sizeof(entries[0])); ++i)
+	{
+		const HeaderEntry& entry = entries[i];
+		uint slot = hash(entry.header, qstrlen(entry.header));
+		Q_ASSERT_X(hashTable[slot] == 0 || hashTable[slot] == &entry, "Receiver::init", "headers collide, change HashSeed");
+		hashTable[slot]         = &entry;
+		parsers[entry.dataType] = entry.parser;
+		classes[entry.dataType] = entry.messageClass;
+		headers[entry.dataType] = entry.header;
+	}
+}
 
 //////////////////////////////////////////////////////////////////////////
 Sender::Sender(Connection* c) {
@@ -323,42 +648,113 @@ QString Sender::getUserName() const {
 	return connection->getUserName();
 }
 
-void Sender::send(const QByteArray& packet) {
+void Sender::send(const QByteArray& packet)
+{
+	TraceSpan span("Sender::send", connection->getID());
+	if(!connection->isReadyForUse())
+		return;
+
+	connection->getOutbox()->push(packet);
+}
+
+// the lane and the compression of a concatenation are those of the bulkiest packet in it
+void Sender::send(const QList<QByteArray>& packets)
+{
+	QByteArray concatenated;
+	Outbox::Lane lane = Outbox::Interactive;
+	bool compress = false;
+	foreach(const QByteArray& packet, packets)
+	{
+		if(packet.isEmpty())
+			continue;
+		concatenated.append(packet);
+		if(Outbox::getLane(packet) == Outbox::Bulk)
+			lane = Outbox::Bulk;
+		compress = compress || shouldCompress(packet);
+	}
+	if(concatenated.isEmpty())
+		return;
+
+	TraceSpan span("Sender::send", connection->getID());
 	if(connection->isReadyForUse())
-		connection->write(packet);
+		connection->getOutbox()->push(concatenated, lane, compress);
 }
 
-// make a packet from header and body
-// add length and delimiters
-QByteArray Sender::makePacket(const QByteArray& header, const QByteArray& body)
+// by the threshold of its header
+bool Sender::shouldCompress(const QByteArray& packet)
 {
-	QByteArray packet(header);
+	int headerSize = packet.indexOf(Connection::Delimiter1);
+	if(headerSize < 0)
+		return false;
+	int threshold = Compressor::getThreshold(packet.constData(), headerSize);
+	return threshold >= 0 && packet.size() >= threshold;
+}
+
+// CHUNK#size#lane#more#data
+QByteArray Sender::makeChunk(int lane, bool more, const char* data, int size)
+{
+	char prefix[8];
+	int prefixLength = qsnprintf(prefix, sizeof(prefix), "%d%c%d%c", lane, Connection::Delimiter1,
+								 more ? 1 : 0, Connection::Delimiter1);
+	QByteArray packet = beginPacket("CHUNK", prefixLength + size);
+	packet.append(prefix, prefixLength).append(data, size);
+	return packet;
+}
+
+// header#size#, with the room for the body reserved
+QByteArray Sender::beginPacket(const QByteArray& header, int bodySize)
+{
+	char size[16];
+	int sizeLength = qsnprintf(size, sizeof(size), "%d", bodySize);
+	QByteArray packet;
+	packet.reserve(header.size() + sizeLength + bodySize + 2);
+	packet.append(header);
 	if(!header.endsWith(Connection::Delimiter1))
 		packet.append(Connection::Delimiter1);
-	packet.append(QByteArray::number(body.length()) + Connection::Delimiter1 + body);
+	packet.append(size, sizeLength).append(Connection::Delimiter1);
 	return packet;
 }
 
+// make a packet from header and body
+// add length and delimiters
+QByteArray Sender::makePacket(const QByteArray& header, const QByteArray& body) {
+	return beginPacket(header, body.size()).append(body);
+}
+
 // join multiple bodies
 QByteArray Sender::makePacket(const QByteArray& header, const QList<QByteArray>& bodies)
 {
-	QByteArray joined;
-	foreach(QByteArray body, bodies)
-		joined.append(body + Connection::Delimiter1);
-	joined.chop(1);    // chop the last '#'
-	return makePacket(header, joined);
+	int size = 0;
+	for(int i = 0; i < bodies.size(); ++i)
+		size += bodies[i].size() + 1;
+	QByteArray packet = beginPacket(header, qMax(size - 1, 0));   // no '#' after the last
+	for(int i = 0; i < bodies.size(); ++i)
+	{
+		if(i > 0)
+			packet.append(Connection::Delimiter1);
+		packet.append(bodies[i]);
+	}
+	return packet;
 }
 
 // header can be customized (EVENT | EVENT_REPLY, they share the same body format)
-QByteArray Sender::makeEventPacket(const QByteArray& header, const TeamRadarEvent& event) {
-	return makePacket(header, QList<QByteArray>() << event.userName.toUtf8()
-												  << event.eventType.toUtf8()
-												  << event.parameters.toUtf8()
-												  << event.time.toString(MainWnd::dateTimeFormat).toUtf8());
+// Format of body: user#event type#parameters#time[#sequence]
+// the body is the one encoded in the event, so the UTF-8 is not made again for each packet
+QByteArray Sender::makeEventPacket(const QByteArray& header, const TeamRadarEvent& event, qint64 sequence)
+{
+	const QByteArray& body = event.getBody();
+	if(sequence < 0)
+		return makePacket(header, body);
+
+	char number[24];
+	int numberLength = qsnprintf(number, sizeof(number), "%lld", sequence);
+	return beginPacket(header, body.size() + numberLength + 1)
+			.append(body).append(Connection::Delimiter1).append(number, numberLength);
 }
 
-QByteArray Sender::makeEventPacket(const TeamRadarEvent& event) {
-	return makeEventPacket("EVENT", event);
+// broadcast events carry the sequence number of their project
+QByteArray Sender::makeEventPacket(const TeamRadarEvent& event, qint64 sequence) {
+	return makeEventPacket("EVENT", event, sequence);
 }
 
 // respond to offline events request
@@ -367,6 +763,11 @@ QByteArray Sender::makeEventsReply(const TeamRadarEvent& event) {
 	return makeEventPacket("EVENTS_REPLY", event);
 }
 
+// ends a page of EVENTS_REPLY, empty token for the last page
+QByteArray Sender::makeEventsPageEnd(const QByteArray& nextToken) {
+	return makePacket("EVENTS_PAGE_END", nextToken);
+}
+
 QByteArray Sender::makeTeamMembersReply(const QList<QByteArray>& userList) {
 	return makePacket("TEAMMEMBERS_REPLY", userList);
 }
@@ -394,5 +795,29 @@ QByteArray Sender::makeLocationReply(const QString& targetUser, const QString& l
 	return makePacket("LOCATION_REPLY", QList<QByteArray>() << targetUser.toUtf8()
 															   << location.toUtf8());
 }
+QByteArray Sender::makeTeamSnapshot(const QList<QByteArray>& members) {
+	return makePacket("TEAM_SNAPSHOT", members);
+}
+
+QByteArray Sender::makeActivityReply(const QList<QByteArray>& rows) {
+	return makePacket("ACTIVITY_REPLY", rows);
+}
+
+QByteArray Sender::makeFileActivityReply(const QString& prefix, const QList<QByteArray>& rows) {
+	return makePacket("FILE_ACTIVITY_REPLY", QList<QByteArray>() << prefix.toUtf8() << rows);
+}
+
+// Format of BUSY: header of the rejected message#reason
+// reason: OVERLOADED (try again later), RATE_LIMITED (slow down)
+QByteArray Sender::makeBusyReply(const QByteArray& header, const QByteArray& reason) {
+	return makePacket("BUSY", QList<QByteArray>() << header << reason);
+}
+
+// Format of RESUME: [OK]/[GAP];last sequence
+// OK: the missed EVENTs follow; GAP: they are gone, query the history with REQ_EVENTS
+QByteArray Sender::makeResumeReply(bool resumed, qint64 lastSequence) {
+	return makePacket("RESUME", QByteArray(resumed ? "OK" : "GAP") + Connection::Delimiter2
+															 + QByteArray::number(lastSequence));
+}
 
 
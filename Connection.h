@@ -1,27 +1,38 @@
 #ifndef CONNECTION_H
 #define CONNECTION_H
 
-#include <QTcpSocket>
+#include <QIODevice>
 #include <QTimer>
 #include <QTime>
 #include <QStringList>
 #include <QSet>
+#include <QQueue>
 #include "MainWnd.h"
+#include "Subscription.h"
+#include "CommandHandler.h"
+#include "RateLimiter.h"
+#include "TimerWheel.h"
+#include "MemoryUsage.h"
+#include "Compressor.h"
+#include "Outbox.h"
 
 class Connection;
 class Sender;
+class Scheduler;
 
-// Parses the message header & body from Connection
+// Parses the message header & body from Connection, and hands the result to the CommandHandler
 // Clients do not send their user names, as they have signed up with GREETING.
 // Format of packet: header#size#body
-class Receiver : public QObject
+class Receiver
 {
-	Q_OBJECT
-
 public:
 	typedef enum {
 		Undefined,      // Format of body see below:
-		Greeting,       // GREETING: [OK, CONNECTED]/[WRONG_USER]
+		Greeting,       // GREETING: user name[#last sequence[#options]]
+						//   reply: [OK, CONNECTED[#accepted options]]/[WRONG_USER]
+						//   with the last sequence of EVENT seen, the session is resumed, see RESUME
+						//   options: option1;option2;..., DEFLATE for compression, see Compressor
+						//            CHUNKED for large packets in chunks, see Outbox
 		ChangeName,     // new name
 		Event,          // EVENT: event type#parameters
 						// Format of parameters: parameter1#parameter2#...
@@ -32,17 +43,35 @@ public:
 						//	recipients = name1;name2;...
 		ReqPhoto,       // REQ_PHOTO: target user name
 		ReqColor,       // REQ_COLOR: target user name
-		ReqEvents,	    // REQ_EVENTS: user list#event types#time span#phases#fuzziness
+		ReqEvents,	    // REQ_EVENTS: user list#event types#time span#phases#fuzziness[#page size[#token]]
 						//   user list: name1;name2;...
 						//   event types: type1;type2;...
 						//   time span: start time;end time
 						//   phases: phase1;phase2;...
 						//   fuzziness: an integer for percentage
+						//   page size: max number of events in the reply, 0 for the server's limit
+						//   token: opaque, from the EVENTS_PAGE_END of the previous page
 		ReqTimeSpan,    // REQ_TIMESPAN: [empty]
 		ReqProjects,    // REQ_PROJECTS: [empty]
 		ReqTeamMembers, // REQ_ALLUSERS: [empty], server knows the user name
 		ReqLocation,    // targetUser
-		ReqOnline       // targetUser
+		ReqOnline,      // targetUser
+		ReqSnapshot,    // REQ_SNAPSHOT: [empty], server knows the project
+		ReqFileActivity,// REQ_FILE_ACTIVITY: path prefix#max results
+						//   reply: FILE_ACTIVITY_REPLY: prefix#row1#row2#..., row: user;last time;count
+		ReqActivity,    // REQ_ACTIVITY: time span#resolution#user list#event types
+						//   time span: start time;end time
+						//   resolution: HOUR/DAY
+						//   reply: ACTIVITY_REPLY: row1#row2#..., row: user;event type;bucket;count
+		ReqBatch,       // REQ_BATCH: request1#request2#...
+						//   request: header;target user, e.g., REQ_COLOR;name
+						//   supports REQ_ONLINE, REQ_PHOTO, REQ_COLOR, REQ_LOCATION
+						//   replies are sent in one write, in the same format as their single versions
+		Subscribe,      // SUBSCRIBE: event types#teammates#intervals, see Subscription
+		Ping,           // PING: [empty], reply: PONG
+						//   a client that sends PING is sent PINGs when idle, and dropped if it does not answer
+		Pong,           // PONG: [empty], the answer to the server's PING
+		NumDataTypes
 	} DataType;
 
 	typedef void(Receiver::*Parser)(const QByteArray& buffer);
@@ -50,33 +79,20 @@ public:
 public:
 	Receiver(Connection* c);
 	void processData(Receiver::DataType dataType, const QByteArray& buffer);
-	DataType guessDataType(const QByteArray& header);
+	DataType guessDataType(const QByteArray& header);               // header with or without '#'
+	static DataType findDataType(const char* header, int size);     // without '#'
+	static QByteArray getHeader(DataType dataType);
+	static bool isBulk(DataType dataType);   // history and photos, see RateLimiter
+	Connection* getConnection() const { return connection; }
 	Sender*  getSender() const;
 	QString  getUserName() const;
+	CommandHandler* getHandler() const;   // 0 without a connection
 
 	static void init();       // init header - parser associations
 
-	// parsing result
-signals:
-	void newEvent(const QString& from, const QByteArray& message);
-	void chatMessage(const QList<QByteArray>& recipients, const QByteArray& content);
-	void joinProject(const QString& projectName);
-	void reqTeamMembers();
-	void regPhoto (const QString& user, const QByteArray& photo);
-	void regColor (const QString& user, const QByteArray& color);
-	void reqOnline(const QString& targetUser);
-	void reqPhoto (const QString& targetUser);
-	void reqColor (const QString& targetUser);
-	void reqEvents(const QStringList& users, const QStringList& eventTypes,
-					   const QDateTime& startTime, const QDateTime& endTime,
-					   const QStringList& phases, int fuzziness);
-	void reqTimeSpan();
-	void reqProjects();
-	void reqLocation(const QString& targetUser);
-
 	// parsers
 private:
-	void parseGreeting      (const QByteArray& userName);
+	void parseGreeting      (const QByteArray& buffer);
 	void parseChangeName    (const QByteArray& newName);
 	void parseEvent         (const QByteArray& buffer);
 	void parseReqEvents     (const QByteArray& buffer);
@@ -91,102 +107,213 @@ private:
 	void parseReqProjects   (const QByteArray& buffer);
 	void parseJoinProject   (const QByteArray& buffer);
 	void parseReqLocation   (const QByteArray& buffer);
+	void parseSubscribe     (const QByteArray& buffer);
+	void parseReqSnapshot   (const QByteArray& buffer);
+	void parseReqActivity   (const QByteArray& buffer);
+	void parseReqFileActivity(const QByteArray& buffer);
+	void parseReqBatch      (const QByteArray& buffer);
+	void parsePing          (const QByteArray& buffer);
+	void parsePong          (const QByteArray& buffer);
+
+private:
+	struct HeaderEntry
+	{
+		const char* header;
+		DataType    dataType;
+		Parser      parser;
+		RateLimiter::MessageClass messageClass;
+	};
+
+	static uint hash(const char* header, int size);
+	bool admit(DataType dataType);   // false if rejected, and BUSY is sent
+
+private:
+	Connection* connection;
+
+	// dispatch without allocation: header -(perfect hash)-> entry, data type -(array)-> parser
+	static const HeaderEntry  entries[];
+	static const HeaderEntry* hashTable[];
+	static Parser     parsers[NumDataTypes];
+	static RateLimiter::MessageClass classes[NumDataTypes];
+	static QByteArray headers[NumDataTypes];   // for tracing
+	static const int  HashSize = 64;
+	static const uint HashSeed = 28;           // no collisions of the headers, checked by init()
+};
+
+struct TeamRadarEvent;
+
+// Format and send packets
+// Formatting (makeXXX) and sending (send) are separated for flexibility
+class Sender
+{
+public:
+	Sender(Connection* c);
+	QString getUserName() const;
+	void send(const QByteArray& packet);  // queue the formatted packet on its lane, see Outbox
+	void send(const QList<QByteArray>& packets);   // in one write, on the lane of the bulkiest
+
+	// format the packet
+	static QByteArray makePacket(const QByteArray& header, const QByteArray& body = QByteArray());
+	static QByteArray makePacket(const QByteArray& header, const QList<QByteArray>& bodies);
+	static QByteArray makeEventPacket(const TeamRadarEvent& event, qint64 sequence = -1);
+	static QByteArray makeChatPacket(const QString& user, const QByteArray& content);
+	static QByteArray makeTeamMembersReply(const QList<QByteArray>& userList);
+	static QByteArray makeOnlineReply(const QString& targetUser, bool online);
+	static QByteArray makePhotoReply (const QString& fileName,   const QByteArray& photoData);
+	static QByteArray makeColorReply (const QString& targetUser, const QByteArray& color);
+	static QByteArray makeEventsReply(const TeamRadarEvent& event);
+	static QByteArray makeEventsPageEnd(const QByteArray& nextToken);
+	static QByteArray makeTimeSpanReply(const QByteArray& start, const QByteArray& end);
+	static QByteArray makeProjectsReply(const QList<QByteArray>& projects);
+	static QByteArray makeLocationReply(const QString& targetUser, const QString& location);
+	static QByteArray makeTeamSnapshot(const QList<QByteArray>& members);
+	static QByteArray makeActivityReply(const QList<QByteArray>& rows);
+	static QByteArray makeFileActivityReply(const QString& prefix, const QList<QByteArray>& rows);
+	static QByteArray makeResumeReply(bool resumed, qint64 lastSequence);
+	static QByteArray makeBusyReply(const QByteArray& header, const QByteArray& reason);
+	static QByteArray makeChunk(int lane, bool more, const char* data, int size);
+	static bool shouldCompress(const QByteArray& packet);   // on a connection with compression
+
+private:
+	static QByteArray makeEventPacket(const QByteArray& header, const TeamRadarEvent& event,
+									  qint64 sequence = -1);
+	static QByteArray beginPacket(const QByteArray& header, int bodySize);
 
 private:
 	Connection* connection;
-	static QMap<QString, DataType> dataTypes;  // header -> datatype
-	static QMap<DataType, Parser>  parsers;    // datatype -> parser
 };
 
-// A TCP socket connected to the server
+
+// A client connected to the server, through a TCP or a local (Unix domain) socket
 // NOT a singleton: one connection for each client
 // After the connection is set up,
 // the parsing and composition of messages are handed to Receiver and Sender, respectively
-class Connection : public QTcpSocket
+class Connection : public QObject
 {
 	Q_OBJECT
 
 public:
-	Connection(QObject* parent = 0);
+	Connection(QIODevice* socket, CommandHandler* handler, QObject* parent = 0);   // takes the ownership of the socket
+	~Connection();
+	quint32   getID()         const { return id;       }
 	QString   getUserName()   const { return userName; }
-	Receiver* getReceiver()   const { return receiver; }
-	Sender*   getSender()     const { return sender;   }
+	QByteArray getUserNameUtf8() const { return userNameUtf8; }   // for encoding its events
+	Receiver* getReceiver()         { return &receiver; }
+	Sender*   getSender()           { return &sender;   }
+	Outbox*   getOutbox()           { return &outbox;   }
+	CommandHandler* getHandler() const { return handler; }
 	bool      isReadyForUse() const { return ready;    }
+	qint64    getResumeSequence() const { return resumeSequence; }
+	void      setResumeSequence(qint64 sequence) { resumeSequence = sequence; }
+	Subscription& getSubscription() { return subscription; }
+	RateLimiter&  getLimiter()      { return limiter; }
+	void setSubscription(const Subscription& s) { subscription = s; }
+	bool accepts(const QString& source, int typeBit, const QString& eventType);   // an EVENT, live or replayed
 	void setUserName(const QString& name);
 	void setReadyForUse();
+	qint64 write(const QByteArray& data) { return socket->write(data); }   // bypassing the outbox
+	qint64 getNumBytesToWrite() const { return socket->bytesToWrite(); }
+	void   abort();
+	void   drop();   // abort, and disconnect now
+	Compressor* getCompressor() const { return compressor; }   // 0 if not negotiated
+	void setCompression(bool enable);
 
-	static bool userExists(const QString& userName);
+	// inbound packets are framed into a queue, and processed in slices by the Scheduler
+	// without a scheduler, they are processed as soon as they arrive
+	void setScheduler(Scheduler* s) { scheduler = s; }
+	void setTimerWheel(TimerWheel* w);   // for the transfer and keepalive deadlines, none without it
+	void setKeepAlive();   // the client has sent a PING, and will answer the server's
+	static void setKeepAliveTimes(int interval, int timeout);   // msecs, 0 interval for no PING
+	bool hasPackets() const { return !packets.isEmpty(); }
+	bool isNextBulk() const;   // the packet at the head is a bulk request
+	int  processPackets(int max, bool bulk);   // stops before a bulk packet if !bulk, returns the number processed
 
-protected:
-	void timerEvent(QTimerEvent* timerEvent);   // transfer timeout
+	MemoryUsage getMemoryUsage() const;
 
-signals:
-	void readyForUse();    // connected
-	void changeName(const QString& oldName, const QString& newName);
+	static bool userExists(const QString& userName);
 
 private slots:
 	void onReadyRead();    // data coming
 	void onDisconnected();
+	void onBytesWritten();   // the socket has room for more
 
 private:
+	void readPackets();
+	void record();         // feed new inbound bytes to PacketRecorder
+	void frame();          // into the queue, until it is full
 	bool readHeader();
-	int  readDataIntoBuffer(int maxSize = MaxBufferSize);
-	int  getDataLength();
+	bool readToken();      // header or size
+	int  getDataLength();  // -1 if not arrived yet
 	bool hasEnoughData();
-	void processData();
+	void readData();
+	void onTransferTimeout();
+	void onIdle();
 
 public:
-	static const int  MaxBufferSize   = 1024 * 1024;   // 1KB
+	static const int  MaxBufferSize   = 4 * 1024 * 1024;   // 4MB, the largest body accepted, e.g., of a photo
+	static const int  ReadBufferSize  = 64 * 1024;         // of the socket, the rest waits in the kernel
+	static const int  SocketOverhead  = 4 * 1024;          // the socket object, its private part and notifiers, estimated
 	static const int  TransferTimeout = 30 * 1000;
+	static const int  MaxTokenSize    = 32;
+	static const int  MaxQueuedPackets = 64;   // the rest waits in the socket
 	static const char Delimiter1 = '#';
 	static const char Delimiter2 = ';';
 	static const char Delimiter3 = ',';
 
 private:
+	QIODevice* socket;            // QTcpSocket or QLocalSocket
+	quint32    id;                // unique in the process, identifies the connection in captures
 	Receiver::DataType dataType;
 	bool       ready;
-	QByteArray buffer;
+	bool       closed;
+	struct Packet
+	{
+		Receiver::DataType dataType;
+		QByteArray         body;
+	};
+	QQueue<Packet> packets;       // framed, not processed yet
+	Scheduler* scheduler;
+
+	// a deadline on the wheel, calling back a member
+	class Deadline : public TimerWheel::Timer
+	{
+	public:
+		typedef void (Connection::*Handler)();
+		void init(Connection* c, Handler h) { connection = c; handler = h; }
+	protected:
+		void expire() { (connection->*handler)(); }
+	private:
+		Connection* connection;
+		Handler     handler;
+	};
+	TimerWheel* wheel;
+	Deadline   transferTimer;
+	Deadline   idleTimer;         // ping, then reap
+	bool       keepAlive;         // the client answers PING
+	bool       pingSent;          // and not answered yet
+	char       token[MaxTokenSize];   // header or size, until '#'
+	int        tokenSize;
 	int        numBytes;
-	int        transferTimerID;   // for transfer timeout
+	QByteArray body;              // from BufferPool, being read
+	int        numBytesRead;
+	qint64     numBytesRecorded;  // bytes recorded but still unread in the socket
 	QString    userName;
-	Receiver*  receiver;
-	Sender*    sender;
+	QByteArray userNameUtf8;
+	Receiver   receiver;          // parts of the connection, not objects of their own
+	Sender     sender;
+	Outbox     outbox;
+	CommandHandler* handler;
+	Subscription subscription;
+	RateLimiter  limiter;
+	Compressor*  compressor;
+	qint64     resumeSequence;    // last EVENT seen before reconnecting, -1 for a new session
 
 	static QSet<QString> userNames;   // detects name duplication
+	static quint32       nextID;
+	static int           keepAliveInterval;   // msecs
+	static int           keepAliveTimeout;
 };
 
 
-struct TeamRadarEvent;
-
-// Format and send packets
-// Formatting (makeXXX) and sending (send) are separated for flexibility
-class Sender : public QObject
-{
-public:
-	Sender(Connection* c);
-	QString getUserName() const;
-	void send(const QByteArray& packet);  // send the formatted packet
-
-	// format the packet
-	static QByteArray makePacket(const QByteArray& header, const QByteArray& body = QByteArray());
-	static QByteArray makePacket(const QByteArray& header, const QList<QByteArray>& bodies);
-	static QByteArray makeEventPacket(const TeamRadarEvent& event);
-	static QByteArray makeChatPacket(const QString& user, const QByteArray& content);
-	static QByteArray makeTeamMembersReply(const QList<QByteArray>& userList);
-	static QByteArray makeOnlineReply(const QString& targetUser, bool online);
-	static QByteArray makePhotoReply (const QString& fileName,   const QByteArray& photoData);
-	static QByteArray makeColorReply (const QString& targetUser, const QByteArray& color);
-	static QByteArray makeEventsReply(const TeamRadarEvent& event);
-	static QByteArray makeTimeSpanReply(const QByteArray& start, const QByteArray& end);
-	static QByteArray makeProjectsReply(const QList<QByteArray>& projects);
-	static QByteArray makeLocationReply(const QString& targetUser, const QString& location);
-
-private:
-	static QByteArray makeEventPacket(const QByteArray& header, const TeamRadarEvent& event);
-
-private:
-	Connection* connection;
-};
-
 
 #endif // CONNECTION_H
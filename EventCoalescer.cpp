@@ -0,0 +1,100 @@
+#include "EventCoalescer.h"
+
+EventCoalescer::EventCoalescer(QObject* parent)
+	: QObject(parent), window(0)
+{
+	numSubmitted = numSuperseded = 0;
+	timer.setSingleShot(true);
+	clock.start();
+	connect(&timer, SIGNAL(timeout()), this, SLOT(onTimeout()));
+}
+
+void EventCoalescer::setWindow(int msecs) {
+	window = qMax(msecs, 0);
+}
+
+void EventCoalescer::setTypes(const QStringList& list) {
+	types = list.toSet();
+}
+
+bool EventCoalescer::isCoalescable(const QString& eventType) const {
+	return window > 0 && types.contains(eventType);
+}
+
+bool EventCoalescer::submit(const TeamRadarEvent& event)
+{
+	bool relay = submit(event, clock.elapsed());
+	if(!timer.isActive())
+		schedule();
+	return relay;
+}
+
+bool EventCoalescer::submit(const TeamRadarEvent& event, qint64 now)
+{
+	++numSubmitted;
+	Key key(event.userName, event.eventType);
+	QHash<Key, Window>::Iterator it = windows.find(key);
+	if(it == windows.end())   // open a window, and relay
+	{
+		Window& w = windows[key];
+		w.end = now + window;
+		deadlines.enqueue(qMakePair(w.end, key));
+		return true;
+	}
+
+	// hold the latest
+	if(!it->latest.isEmpty())
+		++numSuperseded;
+	it->latest.clear();
+	it->latest << event;
+	return false;
+}
+
+// the held event of a closed window is relayed, and opens a new window
+Events EventCoalescer::takeDue(qint64 now)
+{
+	Events result;
+	while(!deadlines.isEmpty() && deadlines.head().first <= now)
+	{
+		QPair<qint64, Key> deadline = deadlines.dequeue();
+		QHash<Key, Window>::Iterator it = windows.find(deadline.second);
+		if(it == windows.end() || it->end != deadline.first)   // forgotten, or reopened since
+			continue;
+		if(it->latest.isEmpty())
+			windows.erase(it);
+		else
+		{
+			result << it->latest.first();
+			it->latest.clear();
+			it->end = now + window;
+			deadlines.enqueue(qMakePair(it->end, deadline.second));
+		}
+	}
+	return result;
+}
+
+// the deadlines are left to takeDue(), which skips them
+void EventCoalescer::forget(const QString& user)
+{
+	for(QHash<Key, Window>::Iterator it = windows.begin(); it != windows.end();)
+		if(it.key().first == user)
+		{
+			numSuperseded += it->latest.size();
+			it = windows.erase(it);
+		}
+		else
+			++it;
+}
+
+void EventCoalescer::onTimeout()
+{
+	foreach(const TeamRadarEvent& event, takeDue(clock.elapsed()))
+		emit ready(event);
+	schedule();
+}
+
+// wake up at the next deadline
+void EventCoalescer::schedule() {
+	if(!deadlines.isEmpty())
+		timer.start(qMax(deadlines.head().first - clock.elapsed(), qint64(0)));
+}
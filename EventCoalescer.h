@@ -0,0 +1,69 @@
+#ifndef EventCoalescer_h__
+#define EventCoalescer_h__
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QQueue>
+#include <QPair>
+#include <QSet>
+#include <QStringList>
+#include "TeamRadarEvent.h"
+
+// Throttles the fanout of high-frequency events (e.g., SAVE, MODE)
+// The first event of a user & type is relayed at once, and opens a window
+// Later events in the window supersede each other, the latest is relayed when the window closes
+// Logging is not affected, see PersistencePolicy
+class EventCoalescer : public QObject
+{
+	Q_OBJECT
+
+	typedef QPair<QString, QString> Key;   // user, event type
+
+	struct Window
+	{
+		qint64 end;
+		Events latest;   // superseded event waiting for the end, at most one
+	};
+
+public:
+	EventCoalescer(QObject* parent = 0);
+
+	void setWindow(int msecs);                  // 0 disables coalescing
+	void setTypes(const QStringList& types);
+	bool isCoalescable(const QString& eventType) const;
+
+	// true if the event is to be relayed now; otherwise it is held or superseded
+	bool submit(const TeamRadarEvent& event);
+	bool submit(const TeamRadarEvent& event, qint64 now);
+	Events takeDue(qint64 now);                 // held events whose windows have closed
+	void forget(const QString& user);           // the windows of a user gone or renamed, held events dropped
+
+	// statistics
+	qint64 getNumSubmitted()  const { return numSubmitted;  }
+	qint64 getNumSuperseded() const { return numSuperseded; }   // never relayed
+
+signals:
+	void ready(const TeamRadarEvent& event);   // a held event is due
+
+private slots:
+	void onTimeout();
+
+private:
+	void schedule();
+
+private:
+	int           window;
+	QSet<QString> types;
+
+	QHash<Key, Window>            windows;     // open windows
+	QQueue<QPair<qint64, Key> >   deadlines;   // in time order, as all windows have the same length
+	QTimer                        timer;
+	QElapsedTimer                 clock;
+
+	qint64 numSubmitted;
+	qint64 numSuperseded;
+};
+
+#endif // EventCoalescer_h__
@@ -0,0 +1,41 @@
+#include "EventRing.h"
+#include <QDateTime>
+
+EventRing::EventRing(int capacity)
+	: packets(qMax(capacity, 1)), head(0), count(0)
+{
+	next = QDateTime::currentMSecsSinceEpoch() * 1000;
+	last = next - 1;
+}
+
+qint64 EventRing::nextSequence() {
+	return next++;
+}
+
+void EventRing::append(qint64 sequence, const QByteArray& packet, const QString& source, const QString& eventType)
+{
+	int index;
+	if(count == packets.size())   // full, overwrite the oldest
+	{
+		index = head;
+		head = (head + 1) % packets.size();
+	}
+	else
+		index = (head + count++) % packets.size();
+	Entry& entry = packets[index];
+	entry.packet    = packet;
+	entry.source    = source;
+	entry.eventType = eventType;
+	last = sequence;
+}
+
+bool EventRing::getSince(qint64 lastSeen, QList<Entry>& result) const
+{
+	qint64 first = last - count + 1;
+	if(lastSeen < first - 1 || lastSeen > last)   // gap, or from another ring
+		return false;
+
+	for(qint64 sequence = lastSeen + 1; sequence <= last; ++sequence)
+		result << packets.at((head + int(sequence - first)) % packets.size());
+	return true;
+}
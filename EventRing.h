@@ -0,0 +1,43 @@
+#ifndef EventRing_h__
+#define EventRing_h__
+
+#include <QVector>
+#include <QByteArray>
+#include <QString>
+#include <QList>
+
+// The most recent encoded EVENT packets of a project, for resuming sessions
+// Sequence numbers are contiguous within a project, and start from the creation time
+// of the ring (msecs * 1000), so that they keep increasing across server restarts
+// Each packet keeps its source and type, so a replay is filtered as the live relay was
+class EventRing
+{
+public:
+	struct Entry
+	{
+		QByteArray packet;
+		QString    source;      // user
+		QString    eventType;
+	};
+
+	EventRing(int capacity = DefaultCapacity);
+
+	qint64 nextSequence();                              // take a new number
+	qint64 lastSequence() const { return last; }
+	void   append(qint64 sequence, const QByteArray& packet, const QString& source, const QString& eventType);
+
+	// entries after lastSeen, false if some of them have left the ring
+	bool getSince(qint64 lastSeen, QList<Entry>& result) const;
+
+public:
+	static const int DefaultCapacity = 1000;
+
+private:
+	QVector<Entry> packets;   // circular
+	int    head;                   // index of the oldest
+	int    count;
+	qint64 last;                   // sequence of the newest
+	qint64 next;
+};
+
+#endif // EventRing_h__
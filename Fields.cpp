@@ -0,0 +1,96 @@
+#include "Fields.h"
+#include <limits.h>
+
+bool Field::operator==(const char* other) const {
+	return qstrlen(other) == uint(size) && memcmp(data, other, size) == 0;
+}
+
+int Field::toInt(bool* ok) const
+{
+	bool valid;
+	qint64 result = toLongLong(&valid);
+	valid = valid && result >= INT_MIN && result <= INT_MAX;   // not truncated, e.g., a size
+	if(ok != 0)
+		*ok = valid;
+	return valid ? int(result) : 0;
+}
+
+qint64 Field::toLongLong(bool* ok) const
+{
+	if(ok != 0)
+		*ok = false;
+	int i = 0;
+	bool negative = size > 0 && (data[0] == '-' || data[0] == '+');
+	if(negative)
+		negative = data[i++] == '-';
+	if(i == size)
+		return 0;
+
+	qint64 result = 0;
+	for(; i < size; ++i)
+	{
+		if(data[i] < '0' || data[i] > '9')
+			return 0;
+		int digit = data[i] - '0';
+		if(result > (LLONG_MAX - digit) / 10)   // would overflow
+			return 0;
+		result = result * 10 + digit;
+	}
+	if(ok != 0)
+		*ok = true;
+	return negative ? -result : result;
+}
+
+QDateTime Field::toDateTime(const QString& format) const {
+	return QDateTime::fromString(QString::fromLatin1(data, size), format);
+}
+
+QStringList Field::split(char delimiter, bool skipEmpty) const
+{
+	QStringList result;
+	int start = 0;
+	for(int i = 0; i <= size; ++i)
+		if(i == size || data[i] == delimiter)
+		{
+			if(i > start || !skipEmpty)
+				result << QString::fromUtf8(data + start, i - start);
+			start = i + 1;
+		}
+	return result;
+}
+
+QList<QByteArray> Field::splitBytes(char delimiter) const
+{
+	QList<QByteArray> result;
+	int start = 0;
+	for(int i = 0; i <= size; ++i)
+		if(i == size || data[i] == delimiter)
+		{
+			result << QByteArray(data + start, i - start);
+			start = i + 1;
+		}
+	return result;
+}
+
+//////////////////////////////////////////////////////////////////////////
+Fields::Fields(const QByteArray& frame, char delimiter) {
+	split(frame.constData(), frame.size(), delimiter);
+}
+
+Fields::Fields(const Field& frame, char delimiter) {
+	split(frame.data, frame.size, delimiter);
+}
+
+// as QByteArray::split(), an empty frame has one empty field
+void Fields::split(const char* data, int size, char delimiter)
+{
+	count = 0;
+	int start = 0;
+	for(int i = 0; i < size && count < MaxFields - 1; ++i)
+		if(data[i] == delimiter)
+		{
+			fields[count++] = Field(data + start, i - start);
+			start = i + 1;
+		}
+	fields[count++] = Field(data + start, size - start);
+}
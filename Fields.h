@@ -0,0 +1,50 @@
+#ifndef Fields_h__
+#define Fields_h__
+
+#include <QByteArray>
+#include <QStringList>
+#include <QDateTime>
+
+// A non-owning view of a part of a frame, e.g., a field of header#size#body
+// Valid as long as the frame is; copy it by toByteArray() or toString() to keep it longer
+struct Field
+{
+	Field() : data(0), size(0) {}
+	Field(const char* d, int s) : data(d), size(s) {}
+
+	bool operator==(const char* other) const;
+	bool isEmpty() const { return size == 0; }
+	int        toInt     (bool* ok = 0) const;   // 0 and !ok if not a number or out of range,
+	qint64     toLongLong(bool* ok = 0) const;   // as QByteArray::toInt()
+	QByteArray toByteArray() const { return QByteArray(data, size); }
+	QString    toString()    const { return QString::fromUtf8(data, size); }
+	QDateTime  toDateTime(const QString& format) const;
+	QStringList       split(char delimiter, bool skipEmpty = false) const;
+	QList<QByteArray> splitBytes(char delimiter) const;
+
+	const char* data;
+	int         size;
+};
+
+// Splits a frame into Fields by a delimiter, without allocating
+// Fields beyond MaxFields are left in the last one
+class Fields
+{
+public:
+	Fields(const QByteArray& frame, char delimiter);
+	Fields(const Field& frame, char delimiter);
+	int size() const { return count; }
+	const Field& operator[](int i) const { return fields[i]; }
+
+public:
+	static const int MaxFields = 16;
+
+private:
+	void split(const char* data, int size, char delimiter);
+
+private:
+	Field fields[MaxFields];
+	int   count;
+};
+
+#endif // Fields_h__
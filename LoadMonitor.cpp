@@ -0,0 +1,42 @@
+#include "LoadMonitor.h"
+
+bool   LoadMonitor::overloaded = false;
+int    LoadMonitor::lag        = 0;
+qint64 LoadMonitor::numShed    = 0;
+
+LoadMonitor::LoadMonitor(QObject* parent) : QObject(parent)
+{
+	threshold = 0;
+	connect(&timer, SIGNAL(timeout()), this, SLOT(onTimeout()));
+}
+
+void LoadMonitor::setThreshold(int msecs)
+{
+	threshold = msecs;
+	overloaded = false;
+	lag = 0;
+	if(threshold > 0)
+	{
+		elapsed.start();
+		timer.start(Interval);
+	}
+	else
+		timer.stop();
+}
+
+void LoadMonitor::onTimeout()
+{
+	addSample(qMax(0, int(elapsed.restart()) - Interval));
+}
+
+// moving average over about 8 samples
+void LoadMonitor::addSample(int sample)
+{
+	if(threshold <= 0)
+		return;
+	lag = (lag * 7 + sample) / 8;
+	if(!overloaded && lag > threshold)
+		overloaded = true;
+	else if(overloaded && lag < threshold / 2)
+		overloaded = false;
+}
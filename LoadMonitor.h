@@ -0,0 +1,41 @@
+#ifndef LoadMonitor_h__
+#define LoadMonitor_h__
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+
+// Measures the lag of the event loop, i.e., how long a handler waits for the ones before it
+// by how late a periodic timer fires
+// The server sheds the expensive requests while the lag is over the threshold,
+// and until it falls below half of it
+class LoadMonitor : public QObject
+{
+	Q_OBJECT
+
+public:
+	LoadMonitor(QObject* parent = 0);
+	void setThreshold(int msecs);   // 0 for never shedding
+	void addSample(int lag);        // msecs, smoothed
+
+	static bool isOverloaded()  { return overloaded; }
+	static int  getLag()        { return lag; }
+	static qint64 getNumShed()  { return numShed; }
+	static void   countShed()   { ++numShed; }
+
+private slots:
+	void onTimeout();
+
+private:
+	QTimer        timer;
+	QElapsedTimer elapsed;    // since the last timeout
+	int           threshold;
+
+	static bool   overloaded;
+	static int    lag;        // msecs
+	static qint64 numShed;    // requests answered with BUSY
+
+	static const int Interval = 50;   // msecs
+};
+
+#endif // LoadMonitor_h__
@@ -0,0 +1,338 @@
+#include "LogShards.h"
+#include "QueryExecutor.h"
+#include "UsersModel.h"
+#include "MainWnd.h"
+#include <QSqlQuery>
+#include <QDebug>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QUrl>
+
+namespace {
+
+// writes the pending events of a shard, on its worker thread
+class ShardWriter : public DBJob
+{
+public:
+	ShardWriter(const QString& p, const Events& e) : DBJob(0), project(p), events(e) {}
+	void run(QSqlDatabase& database);
+	QString getProject() const { return project; }
+
+private:
+	QString project;
+	Events  events;
+};
+
+void ShardWriter::run(QSqlDatabase& database)
+{
+	database.transaction();
+	QSqlQuery query(database);
+	query.exec("select max(ID) from Logs");
+	int id = query.next() ? query.value(0).toInt() + 1 : 0;
+	query.prepare("insert into Logs values (?, ?, ?, ?, ?)");
+	foreach(const TeamRadarEvent& event, events)
+	{
+		query.addBindValue(id++);
+		query.addBindValue(event.getTimeText());
+		query.addBindValue(event.userName);
+		query.addBindValue(event.eventType);
+		query.addBindValue(event.parameters);
+		query.exec();
+	}
+	database.commit();
+}
+
+}
+
+// moves the events of the project's members from the main db into its shard, on the shard's thread
+// all or nothing: the main db loses the events only if all of them were copied
+// the Logs table of a new shard is created in the same transaction, so a failed move is tried again
+ShardCreator::ShardCreator(const QString& p) : DBJob(0), project(p), succeeded(false), committed(0) {}
+
+void ShardCreator::run(QSqlDatabase& database)
+{
+	QSqlQuery query(database);
+	query.prepare("attach database ? as Central");   // not allowed in a transaction
+	query.addBindValue(UsersModel::getDBName());
+	if(!query.exec())
+		return;
+
+	if(database.transaction())
+	{
+		succeeded = move(database) && database.commit();
+		if(succeeded)
+			committed.fetchAndStoreOrdered(1);
+		else
+			database.rollback();
+	}
+	query.exec("detach database Central");
+}
+
+bool ShardCreator::move(QSqlDatabase& database)
+{
+	if(!database.tables().contains("Logs"))
+		UsersModel::createLogTable(database);   // in main, i.e., the shard
+
+	const QString members = "from Central.Logs where Client in \
+							(select Username from Central.Users where Project = ?)";
+	QSqlQuery query(database);
+	query.prepare("select count(*), min(ID) " + members);
+	query.addBindValue(project);
+	if(!query.exec() || !query.next())
+		return false;
+	int count = query.value(0).toInt();
+	if(count == 0)
+		return true;
+	int firstID = query.value(1).toInt();
+
+	// the IDs of the main db may have been reused since the previous move, shifted past the shard's
+	if(!query.exec("select max(ID) from main.Logs") || !query.next())
+		return false;
+	int shift = query.value(0).isNull() ? 0 : qMax(query.value(0).toInt() + 1 - firstID, 0);
+
+	query.prepare("insert into main.Logs select ID + ?, Time, Client, Event, Parameters " + members);
+	query.addBindValue(shift);
+	query.addBindValue(project);
+	if(!query.exec() || query.numRowsAffected() != count)
+		return false;
+
+	query.prepare("delete " + members);
+	query.addBindValue(project);
+	return query.exec() && query.numRowsAffected() == count;
+}
+
+LogShards::LogShards(QObject* parent) : QObject(parent)
+{
+	maxThreads   = 2;
+	idleTimeout  = 300;
+	mainExecutor = 0;
+	connect(&timer, SIGNAL(timeout()), this, SLOT(onCloseIdle()));
+	timer.start(60 * 1000);
+}
+
+// write what is left
+LogShards::~LogShards()
+{
+	foreach(const QString& project, shards.keys())
+		close(project);
+}
+
+void LogShards::setDir(const QString& dirName)
+{
+	dir = dirName;
+	if(!dir.isEmpty())
+		QDir::current().mkpath(dir);
+}
+
+void LogShards::setMaxThreads(int count) {
+	maxThreads = count;
+}
+
+void LogShards::setIdleTimeout(int secs) {
+	idleTimeout = secs;
+}
+
+void LogShards::setMainExecutor(QueryExecutor* executor) {
+	mainExecutor = executor;
+}
+
+bool LogShards::hasShard(const QString& project) const {
+	return isEnabled() && !project.isEmpty() && !unsharded.contains(project);
+}
+
+// logged in the main db during the first move, which the second one moves too
+bool LogShards::isSharded(const QString& project) {
+	return hasShard(project) && getShard(project).state != Moving;
+}
+
+void LogShards::append(const QString& project, const TeamRadarEvent& event)
+{
+	Shard& shard = getShard(project);
+	shard.pending << event;
+	if(!shard.writing)
+		write(project);
+}
+
+void LogShards::submit(const QString& project, DBJob* job)
+{
+	if(!hasShard(project))
+		return mainExecutor->submit(job);
+	Shard& shard = getShard(project);
+	if(shard.state != Ready)
+		shard.held << job;
+	else
+		getExecutor(project)->submit(job);
+}
+
+// of an open shard
+QueryExecutor* LogShards::getExecutor(const QString& project)
+{
+	Shard& shard = shards[project];
+	if(shard.executor == 0)
+	{
+		shard.executor = new QueryExecutor;
+		shard.executor->setDatabaseName(getFileName(project));
+		shard.executor->setMaxThreads(maxThreads);
+	}
+	return shard.executor;
+}
+
+// the main db has all the events of the project until the first move commits
+QSqlDatabase LogShards::getDatabase(const QString& project)
+{
+	if(!hasShard(project))
+		return QSqlDatabase::database();
+	const Shard& shard = getShard(project);
+	if(shard.state == Moving && !shard.creator->isCommitted())
+		return QSqlDatabase::database();
+	return QSqlDatabase::database(getConnectionName(project));
+}
+
+// a shard without a Logs table is created, with the events of its current members in the main db
+LogShards::Shard& LogShards::getShard(const QString& project)
+{
+	QHash<QString, Shard>::Iterator it = shards.find(project);
+	if(it == shards.end())
+	{
+		bool created = false;
+		QSqlDatabase database = QSqlDatabase::addDatabase("QSQLITE", getConnectionName(project));
+		database.setDatabaseName(getFileName(project));
+		if(database.open())
+		{
+			QSqlQuery(database).exec("PRAGMA journal_mode=WAL");
+			created = database.tables().contains("Logs");
+		}
+		it = shards.insert(project, Shard());
+		if(!created)
+		{
+			it->state   = Moving;
+			it->writing = true;   // appended events wait for the moves
+			move(project);
+		}
+	}
+	it->lastUsed = QDateTime::currentDateTime().toTime_t();
+	return *it;
+}
+
+// on the shard's thread, not to stall the GUI
+void LogShards::move(const QString& project)
+{
+	ShardCreator* job = new ShardCreator(project);
+	shards[project].creator = job;
+	connect(job, SIGNAL(finished()), this, SLOT(onCreated()));
+	getExecutor(project)->submit(job);
+}
+
+// if the first move failed, the project stays in the main db, and is tried again on the next start
+// if the second one failed, the events logged during the first stay in the main db
+void LogShards::onCreated()
+{
+	ShardCreator* job = static_cast<ShardCreator*>(sender());
+	QString project = job->getProject();
+	QHash<QString, Shard>::Iterator it = shards.find(project);
+	if(it == shards.end())
+		return;
+	it->creator = 0;
+
+	if(it->state == Moving)
+	{
+		if(!job->isSucceeded())
+		{
+			qDebug() << "Failed to create the log shard of project" << project;
+			unsharded << project;
+			foreach(DBJob* held, it->held)
+				mainExecutor->submit(held);
+			it->held.clear();
+			return close(project);
+		}
+		it->state = CatchingUp;
+		return move(project);
+	}
+
+	if(!job->isSucceeded())
+		qDebug() << "Failed to move the last events of project" << project << "into its shard";
+	it->state   = Ready;
+	it->writing = false;
+	emit shardCreated(project);
+	QList<DBJob*> held = it->held;
+	it->held.clear();
+	foreach(DBJob* waiting, held)
+		getExecutor(project)->submit(waiting);
+	if(!it->pending.isEmpty())
+		write(project);
+}
+
+void LogShards::write(const QString& project)
+{
+	Shard& shard = shards[project];
+	ShardWriter* job = new ShardWriter(project, shard.pending);
+	shard.pending.clear();
+	shard.writing = true;
+	connect(job, SIGNAL(finished()), this, SLOT(onWritten()));
+	getExecutor(project)->submit(job);
+}
+
+void LogShards::onWritten()
+{
+	ShardWriter* job = static_cast<ShardWriter*>(sender());
+	QHash<QString, Shard>::Iterator it = shards.find(job->getProject());
+	if(it == shards.end())
+		return;
+	it->writing = false;
+	emit written(job->getProject());
+	if(!it->pending.isEmpty())   // appended meanwhile
+		write(job->getProject());
+}
+
+void LogShards::onCloseIdle()
+{
+	uint now = QDateTime::currentDateTime().toTime_t();
+	foreach(const QString& project, shards.keys())
+	{
+		const Shard& shard = shards[project];
+		if(!shard.writing && shard.pending.isEmpty() &&
+		   (shard.executor == 0 || shard.executor->getQueueDepth() == 0) &&
+		   now - shard.lastUsed > uint(idleTimeout))
+			close(project);
+	}
+}
+
+// waits for the running jobs, and writes the pending events on this thread
+void LogShards::close(const QString& project)
+{
+	Shard shard = shards.take(project);
+	delete shard.executor;
+	qDeleteAll(shard.held);   // only on shutdown, during a move
+	if(!shard.pending.isEmpty())
+	{
+		QSqlDatabase database = QSqlDatabase::database(getConnectionName(project));
+		if(!database.tables().contains("Logs"))   // not created
+			database = QSqlDatabase::database();
+		ShardWriter(project, shard.pending).run(database);
+	}   // the connection is not in use after this
+	QSqlDatabase::removeDatabase(getConnectionName(project));
+}
+
+QStringList LogShards::getProjects() const
+{
+	QStringList result;
+	if(isEnabled())
+		foreach(const QString& fileName, QDir(dir).entryList(QStringList() << "*.db", QDir::Files))
+			result << QUrl::fromPercentEncoding(QFileInfo(fileName).completeBaseName().toUtf8());
+	return result;
+}
+
+void LogShards::execAll(const QString& sql)
+{
+	foreach(const QString& project, getProjects())
+		QSqlQuery(getDatabase(project)).exec(sql);
+}
+
+QString LogShards::getFileName(const QString& project) const {
+	return dir + "/" + QUrl::toPercentEncoding(project) + ".db";
+}
+
+QString LogShards::getConnectionName(const QString& project) {
+	return "Shard:" + project;
+}
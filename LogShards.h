@@ -0,0 +1,109 @@
+#ifndef LogShards_h__
+#define LogShards_h__
+
+#include <QObject>
+#include <QHash>
+#include <QTimer>
+#include <QStringList>
+#include <QSet>
+#include <QSqlDatabase>
+#include <QAtomicInt>
+#include "TeamRadarEvent.h"
+#include "QueryExecutor.h"
+
+// Moves the events of a project's members from the main db into its shard, see LogShards
+class ShardCreator : public DBJob
+{
+public:
+	ShardCreator(const QString& p);
+	void run(QSqlDatabase& database);
+	QString getProject()  const { return project;   }
+	bool    isSucceeded() const { return succeeded; }   // after finished()
+	bool    isCommitted() const { return committed == 1; }   // any time, from any thread
+
+private:
+	bool move(QSqlDatabase& database);
+
+private:
+	QString    project;
+	bool       succeeded;
+	QAtomicInt committed;
+};
+
+// Stores the logged events of each project in a db of its own: <dir>/<project>.db
+// A shard is opened on first use, and closed after being idle for a while
+// Each shard has its own worker threads, for its writer and for the queries on it
+// Appended events are kept in memory, and written by one job at a time, in one transaction
+// Events of the users without a project stay in the main db, as do all events when sharding is off
+// A new shard is filled by two moves from the main db, off the GUI thread: all the events of the project,
+// then the ones logged in the main db during the first. The events are appended after the first,
+// and the reads of the project are held until the second is done
+class LogShards : public QObject
+{
+	Q_OBJECT
+
+	enum State {Moving, CatchingUp, Ready};   // of the moves filling a new shard
+
+	struct Shard
+	{
+		Shard() : executor(0), writing(false), lastUsed(0), state(Ready), creator(0) {}
+		QueryExecutor* executor;   // 0 until a job is submitted
+		Events         pending;    // not written yet
+		bool           writing;    // a writer job, or a move, is running
+		uint           lastUsed;   // time_t
+		State          state;
+		ShardCreator*  creator;    // the running move
+		QList<DBJob*>  held;       // submitted before the shard is filled
+	};
+
+public:
+	LogShards(QObject* parent = 0);
+	~LogShards();
+
+	void setDir(const QString& dirName);   // empty for no sharding
+	void setMaxThreads(int count);         // of each shard
+	void setIdleTimeout(int secs);
+	void setMainExecutor(QueryExecutor* executor);
+	bool isEnabled() const { return !dir.isEmpty(); }
+	bool isSharded(const QString& project);   // its events are appended to a shard, opened and filled if new
+
+	void append(const QString& project, const TeamRadarEvent& event);
+
+	// to the shard of the project, or to the main db if the project is not sharded
+	void         submit(const QString& project, DBJob* job);   // held while the shard is filled
+	QSqlDatabase getDatabase(const QString& project);          // for the main thread
+
+	QStringList getProjects() const;    // of all the shards on disk
+	void execAll(const QString& sql);   // on every shard, e.g., for clearing the log
+	int  getNumOpen() const { return shards.size(); }
+	QString getFileName(const QString& project) const;
+
+signals:
+	void shardCreated(const QString& project);   // its events were moved from the main db
+	void written(const QString& project);        // appended events are in its db
+
+private slots:
+	void onCreated();
+	void onWritten();
+	void onCloseIdle();
+
+private:
+	bool   hasShard(const QString& project) const;   // sharding is on, and its shard did not fail
+	Shard& getShard(const QString& project);         // open it
+	void   move(const QString& project);
+	QueryExecutor* getExecutor(const QString& project);
+	void   write(const QString& project);
+	void   close(const QString& project);
+	static QString getConnectionName(const QString& project);
+
+private:
+	QString        dir;
+	int            maxThreads;
+	int            idleTimeout;    // secs
+	QueryExecutor* mainExecutor;
+	QHash<QString, Shard> shards;  // open ones
+	QSet<QString>  unsharded;      // failed to be created, logged in the main db until restart
+	QTimer         timer;
+};
+
+#endif // LogShards_h__
@@ -1,5 +1,6 @@
 #include "MainWnd.h"
 #include "Connection.h"
+#include "Setting.h"
 #include <QtGui/QApplication>
 
 int main(int argc, char *argv[])
@@ -11,6 +12,7 @@ int main(int argc, char *argv[])
 
 	QApplication app(argc, argv);
 	app.setQuitOnLastWindowClosed(false);
+	Setting::getInstance()->setArguments(app.arguments());   // e.g., --Port=12346 --ClusterPort=12401
 	MainWnd wnd;
 	wnd.show();
 
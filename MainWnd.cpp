@@ -2,16 +2,24 @@
 #include "Connection.h"
 #include "ImageColorBoolProxy.h"
 #include "ImageColorBoolDelegate.h"
-#include "PhaseDivider.h"
 #include "Setting.h"
+#include "PacketRecorder.h"
+#include "Tracer.h"
+#include "Queries.h"
+#include "Fields.h"
+#include "BufferPool.h"
 #include <QMessageBox>
 #include <QCloseEvent>
 #include <QMenu>
 #include <QNetworkInterface>
 #include <QSqlQuery>
+#include <QSqlDatabase>
 #include <QFileDialog>
 #include <QItemSelectionModel>
 #include <QtAlgorithms>
+#include <QDir>
+#include <QDebug>
+#include <QTimer>
 
 MainWnd::MainWnd(QWidget *parent, Qt::WFlags flags)
 	: QDialog(parent, flags)
@@ -26,14 +34,23 @@ MainWnd::MainWnd(QWidget *parent, Qt::WFlags flags)
 				ui.cbLocalAddresses->findText(setting->getIPAddress()));
 	ui.sbPort->setValue(setting->getPort());
 	onPortChanged(setting->getPort());           // listen
+	server.listenLocal(setting->getLocalSocketName());
+
+	// other server processes sharing the projects
+	cluster.setName(setting->getNodeName());
+	if(cluster.listen(setting->getClusterPort()))
+		cluster.setPeers(setting->getClusterPeers());
+	connect(&cluster, SIGNAL(eventReceived(QString, TeamRadarEvent)),
+			this, SLOT(onClusterEvent(QString, TeamRadarEvent)));
+	connect(&cluster, SIGNAL(groupReceived(QString, QString, QByteArray)),
+			this, SLOT(onClusterGroup(QString, QString, QByteArray)));
+	connect(&cluster, SIGNAL(deliverReceived(QList<QByteArray>, QString, QByteArray)),
+			this, SLOT(onClusterDeliver(QList<QByteArray>, QString, QByteArray)));
+	startCapture();
 
 	// tables
-	modelLogs.setTable("Logs");
-	modelLogs.select();
-	ui.tvLogs->setModel(&modelLogs);
-	ui.tvLogs->hideColumn(LOG_ID);
-	ui.tvLogs->sortByColumn(LOG_TIME, Qt::DescendingOrder);
-	ui.tvLogs->resizeColumnsToContents();
+	modelLogs = 0;
+	logsDirty = false;
 
 	UsersModel::makeAllOffline();
 	modelUsers.setTable("Users");
@@ -54,7 +71,65 @@ MainWnd::MainWnd(QWidget *parent, Qt::WFlags flags)
 	ui.tvUsers->hideColumn(modelUsers.IMAGE);
 	resizeUserTable();
 
-	connect(&server, SIGNAL(newConnection(Connection*)), this, SLOT(onNewConnection(Connection*)));
+	// sub-requests of REQ_BATCH
+	batchRepliers.insert("REQ_ONLINE",   &MainWnd::replyOnline);
+	batchRepliers.insert("REQ_PHOTO",    &MainWnd::replyPhoto);
+	batchRepliers.insert("REQ_COLOR",    &MainWnd::replyColor);   // REQ_LOCATION is queried on a worker thread
+
+	// events of each project in a db of its own, if a shard dir is set
+	shards.setDir(setting->getShardDir());
+	shards.setMaxThreads(setting->getDBThreads());
+	shards.setIdleTimeout(setting->getShardIdleTimeout());
+	shards.setMainExecutor(&executor);
+	snapshots.setLogShards(&shards);
+	connect(&shards, SIGNAL(shardCreated(QString)), this, SLOT(onShardCreated(QString)));
+	connect(&shards, SIGNAL(written(QString)),      this, SLOT(onShardWritten(QString)));
+
+	// the Logs tab shows one db at a time, the main one first
+	ui.cbLogs->addItem(tr("Main"));
+	foreach(const QString& project, shards.getProjects())
+		ui.cbLogs->addItem(project, project);
+	ui.cbLogs->setVisible(shards.isEnabled());
+	showLogs(QString());
+	connect(ui.cbLogs, SIGNAL(currentIndexChanged(int)), this, SLOT(onLogsChosen(int)));
+
+	// who touched which file, the SAVEs after the saved index are caught up from the logs
+	pathIndex.load(pathIndexFileName);
+	QDateTime latestPath = pathIndex.getLatest();
+	pathIndex.backfill(latestPath);
+	foreach(const QString& project, shards.getProjects())
+		pathIndex.backfill(shards.getDatabase(project), project, latestPath);
+	QTimer* timerPathIndex = new QTimer(this);
+	connect(timerPathIndex, SIGNAL(timeout()), this, SLOT(onSavePathIndex()));
+	timerPathIndex->start(60 * 1000);
+
+	// worker threads for the queries
+	executor.setDatabaseName(UsersModel::getDBName());
+	executor.setMaxThreads(setting->getDBThreads());
+
+	// what is logged
+	persistence.parse(setting->getPersistencePolicy());
+
+	// coalescing of high-frequency events
+	coalescer.setWindow(setting->getCoalesceWindow());
+	coalescer.setTypes(setting->getCoalesceTypes());
+	connect(&coalescer, SIGNAL(ready(TeamRadarEvent)), this, SLOT(onCoalesced(TeamRadarEvent)));
+
+	// protection from flooding clients and overload
+	RateLimiter::parse(setting->getRateLimits());
+	loadMonitor.setThreshold(setting->getOverloadThreshold());
+	server.getScheduler()->setSliceSize(setting->getSliceSize());
+	Connection::setKeepAliveTimes(setting->getKeepAliveInterval() * 1000,
+								  setting->getKeepAliveTimeout()  * 1000);
+	server.setMemoryBudget(qint64(setting->getMemoryBudget()) * 1024 * 1024);
+	Compressor::setLevel(setting->getCompressionLevel());
+	Outbox::setChunkSize(setting->getChunkSize() * 1024);
+
+	QTimer* timerStatistics = new QTimer(this);
+	connect(timerStatistics, SIGNAL(timeout()), this, SLOT(onUpdateStatistics()));
+	timerStatistics->start(10 * 1000);
+
+	server.setHandler(this);
 	connect(&modelUsers,   SIGNAL(selected()),        this, SLOT(resizeUserTable()));
 	connect(ui.sbPort,     SIGNAL(valueChanged(int)), this, SLOT(onPortChanged(int)));
 	connect(ui.btClearLog, SIGNAL(clicked()),         this, SLOT(onClearLog()));
@@ -63,7 +138,12 @@ MainWnd::MainWnd(QWidget *parent, Qt::WFlags flags)
 
 void MainWnd::createTray()
 {
+	QAction* actionTrace = new QAction(tr("Trace"), this);
+	actionTrace->setCheckable(true);
+	connect(actionTrace, SIGNAL(toggled(bool)), this, SLOT(onTrace(bool)));
+
 	QMenu* trayMenu = new QMenu(this);
+	trayMenu->addAction(actionTrace);
 	trayMenu->addAction(ui.actionAbout);
 	trayMenu->addAction(ui.actionShutdown);
 
@@ -87,93 +167,148 @@ void MainWnd::closeEvent(QCloseEvent* event)
 void MainWnd::onShutdown()
 {
 	trayIcon->hide();
-	setting->setIPAddress(ui.cbLocalAddresses->currentText());  // save setting
-	setting->setPort(ui.sbPort->value());
+	// save what was changed in the UI, not the overrides of this run
+	if(ui.cbLocalAddresses->currentText() != setting->getIPAddress())
+		setting->setIPAddress(ui.cbLocalAddresses->currentText());
+	if(ui.sbPort->value() != setting->getPort())
+		setting->setPort(ui.sbPort->value());
+	PacketRecorder::stop();
+	onSavePathIndex();
 	Setting::destroySettingManager();
 	qApp->quit();
 }
 
+// record inbound traffic, if a capture dir is set
+void MainWnd::startCapture()
+{
+	QString dirName = setting->getCaptureDir();
+	if(dirName.isEmpty())
+		return;
+
+	QDir::current().mkpath(dirName);
+	QString fileName = dirName + "/" +
+			QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss") + ".cap";
+	if(!PacketRecorder::start(fileName))
+		qDebug() << "Can not open capture file " << fileName;
+}
+
+// show the savings of coalescing & persistence policy, and the query load in the tray
+void MainWnd::onUpdateStatistics()
+{
+	trayIcon->setToolTip(tr("TeamRadar Server\n"
+							"Coalesced events: %1 of %2 not relayed\n"
+							"Log writes skipped: %3\n"
+							"Queries waiting: %4, average wait: %5 ms, max wait: %6 ms\n"
+							"Open shards: %7\n"
+							"Rate limited: %8, shed: %9, event loop lag: %10 ms\n"
+							"Connections: %11, memory: %12 KB (buffers %13, output %14, objects %15), "
+							"pooled: %16 KB, refused: %17, dropped: %18\n"
+							"Compressed: %19 KB to %20 KB, chunks sent: %21\n"
+							"Cluster peers: %22, packets relayed: %23, not crossed: %24")
+						 .arg(coalescer.getNumSuperseded())
+						 .arg(coalescer.getNumSubmitted())
+						 .arg(persistence.getNumSkipped())
+						 .arg(executor.getQueueDepth())
+						 .arg(executor.getAverageWait())
+						 .arg(executor.getMaxWait())
+						 .arg(shards.getNumOpen())
+						 .arg(RateLimiter::getNumRejected())
+						 .arg(LoadMonitor::getNumShed())
+						 .arg(LoadMonitor::getLag())
+						 .arg(server.getNumConnections())
+						 .arg(server.getMemoryUsage().getTotal()  / 1024)
+						 .arg(server.getMemoryUsage().buffers     / 1024)
+						 .arg(server.getMemoryUsage().output      / 1024)
+						 .arg(server.getMemoryUsage().objects     / 1024)
+						 .arg(BufferPool::getPooledBytes() / 1024)
+						 .arg(server.getNumRefused())
+						 .arg(server.getNumShed())
+						 .arg(Compressor::getNumBytesIn()  / 1024)
+						 .arg(Compressor::getNumBytesOut() / 1024)
+						 .arg(Outbox::getNumChunks())
+						 .arg(cluster.getNumPeers())
+						 .arg(cluster.getNumRelayed())
+						 .arg(cluster.getNumSkipped()));
+}
+
+// start tracing, or stop and save the trace
+void MainWnd::onTrace(bool enable)
+{
+	if(enable)
+		return Tracer::start();
+
+	Tracer::stop();
+	QString fileName = "Trace-" + QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss") + ".json";
+	if(Tracer::dump(fileName))
+		trayIcon->showMessage(tr("Trace"), tr("Trace saved to %1").arg(fileName));
+}
+
 void MainWnd::onTrayActivated(QSystemTrayIcon::ActivationReason reason) {
 	if(reason == QSystemTrayIcon::DoubleClick)
 		show();
 }
 
-void MainWnd::onNewConnection(Connection* connection)
+void MainWnd::onDisconnected(Connection* connection)
 {
-	connect(connection, SIGNAL(error(QAbstractSocket::SocketError)),
-			this, SLOT(onDisconnected()));
-	connect(connection, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
-	connect(connection, SIGNAL(readyForUse()),  this, SLOT(onReadyForUse()));
-}
-
-void MainWnd::onDisconnected() {
-	if(Connection* connection = qobject_cast<Connection*>(sender()))
+	if(connectionPool.contains(connection))
 	{
-		if(connectionPool.contains(connection))
-		{
-			connectionPool.remove(connection);
-			broadcast(TeamRadarEvent(connection->getUserName(), "DISCONNECTED"));
-
-			UsersModel::makeOffline(connection->getUserName());
-			modelUsers.select();
-		}
+		connectionPool.remove(connection);
+		coalescer.forget(connection->getUserName());   // no SAVE of the user after DISCONNECTED
+		broadcast(TeamRadarEvent(connection->getUserName(), "DISCONNECTED"));
+		cluster.leave(connection->getUserName());
 
-		connection->deleteLater();
+		UsersModel::makeOffline(connection->getUserName());
+		snapshots.setOnline(connection->getUserName(), false);
+		modelUsers.select();
 	}
+
+	connection->deleteLater();
 }
 
-void MainWnd::onReadyForUse()
+// new client, its messages come to the CommandHandler functions
+void MainWnd::onReadyForUse(Connection* connection)
 {
-	Connection* connection = qobject_cast<Connection*>(sender());
-	if(!connection || connectionPool.contains(connection))
+	if(connectionPool.contains(connection))
 		return;
 
-	// new client
 	connectionPool.insert(connection);
 	log(TeamRadarEvent(connection->getUserName(), "Connected"));
-	connect(connection, SIGNAL(changeName(QString, QString)),
-			this, SLOT(onChangeName(QString, QString)));
-
-	// signals
-	Receiver* receiver = connection->getReceiver();
-	connect(receiver, SIGNAL(reqTeamMembers()), this, SLOT(onReqTeamMembers()));
-	connect(receiver, SIGNAL(reqTimeSpan()),    this, SLOT(onReqTimeSpan()));
-	connect(receiver, SIGNAL(reqProjects()),    this, SLOT(onReqProjects()));
-	connect(receiver, SIGNAL(newEvent(QString, QByteArray)), this, SLOT(onNewEvent(QString, QByteArray)));
-	connect(receiver, SIGNAL(regPhoto(QString, QByteArray)), this, SLOT(onRegPhoto(QString, QByteArray)));
-	connect(receiver, SIGNAL(regColor(QString, QByteArray)), this, SLOT(onRegColor(QString, QByteArray)));
-	connect(receiver, SIGNAL(reqOnline  (QString)), this, SLOT(onReqOnline  (QString)));
-	connect(receiver, SIGNAL(reqPhoto   (QString)), this, SLOT(onReqPhoto   (QString)));
-	connect(receiver, SIGNAL(reqColor   (QString)), this, SLOT(onReqColor   (QString)));
-	connect(receiver, SIGNAL(reqLocation(QString)), this, SLOT(onReqLocation(QString)));
-	connect(receiver, SIGNAL(reqEvents(QStringList, QStringList, QDateTime, QDateTime, QStringList, int)),
-			this,     SLOT(onReqEvents(QStringList, QStringList, QDateTime, QDateTime, QStringList, int)));
-	connect(receiver, SIGNAL(chatMessage(QList<QByteArray>, QByteArray)),
-			this, SLOT(onChat(QList<QByteArray>, QByteArray)));
-	connect(receiver, SIGNAL(joinProject(QString)), this, SLOT(onJointProject(QString)));
+
+	if(connection->getResumeSequence() >= 0)
+		resume(connection);
 
 	// refresh the user table
 	UsersModel::addUser   (connection->getUserName());
 	UsersModel::makeOnline(connection->getUserName());
+	snapshots.setOnline(connection->getUserName(), true);
+	cluster.join(connection->getUserName(), UsersModel::getProject(connection->getUserName()));
 	modelUsers.select();
 }
 
-void MainWnd::onChangeName(const QString& oldName, const QString& newName)
+void MainWnd::onChangeName(Connection*, const QString& oldName, const QString& newName)
 {
 	if(!connectionPool.renameSafe(oldName, newName))
 		return;
 
 	// db
 	QSqlQuery query;
-	query.exec(tr("update Logs set Client = \"%1\" where Client = \"%2\"")
-			   .arg(newName).arg(oldName));
+	QString updateLogs = tr("update Logs set Client = \"%1\" where Client = \"%2\"")
+							.arg(newName).arg(oldName);
+	query.exec(updateLogs);
+	shards.execAll(updateLogs);
 	query.exec(tr("update Users set Username = \"%1\" where Username = \"%2\"")
 			   .arg(newName).arg(oldName));
-	modelLogs.select();
+	rollup.rename(oldName, newName);
+	pathIndex.rename(oldName, newName);
+	coalescer.forget(oldName);
+	refreshLogs();
 	modelUsers.select();
+	snapshots.clear();
 
 	// change the name of the connection
 	connectionPool.rename(oldName, newName);
+	cluster.leave(oldName);
+	cluster.join(newName, UsersModel::getProject(newName));
 }
 
 // find all local IP addresses
@@ -197,38 +332,149 @@ void MainWnd::onPortChanged(int port)
 	server.listen(QHostAddress::Any, port);
 }
 
-void MainWnd::onNewEvent(const QString& user, const QByteArray& message)
+void MainWnd::onNewEvent(Connection* source, const QByteArray& message)
 {
-	QByteArray event      = message.split(Connection::Delimiter1).at(0);
-	QByteArray parameters = message.split(Connection::Delimiter1).at(1);
-	broadcast(TeamRadarEvent(user, event, parameters));
+	TraceSpan span("MainWnd::onNewEvent");
+	QString user = source->getUserName();
+	Fields fields(message, Connection::Delimiter1);   // event type#parameters
+	if(fields.size() < 2)
+		return;
+
+	// the packets to the group are made of the received bytes
+	TeamRadarEvent teamRadarEvent(user, fields[0].toString(), fields[1].toString());
+	teamRadarEvent.setBody(source->getUserNameUtf8(), fields[0], fields[1]);
+	bool isSave = fields[0] == "SAVE";
+	if(isSave)
+		snapshots.setLocation(user, teamRadarEvent.parameters);
+
+	QString project = UsersModel::getProject(user);
+	rollup.add(project, user, teamRadarEvent.eventType, teamRadarEvent.time);
+	if(isSave)
+		pathIndex.add(project, user, teamRadarEvent.parameters, teamRadarEvent.time);
+	if(!coalescer.isCoalescable(teamRadarEvent.eventType))
+		return broadcast(teamRadarEvent);
+
+	// logging and fanout have separate policies
+	log(teamRadarEvent);
+	if(coalescer.submit(teamRadarEvent))
+		relay(teamRadarEvent);
 }
 
+// a held event, whose coalescing window has closed
+void MainWnd::onCoalesced(const TeamRadarEvent& event) {
+	relay(event);
+}
+
+// write the event to the db, if its persistence policy says so
 void MainWnd::log(const TeamRadarEvent& event)
 {
-	int lastRow = modelLogs.rowCount();
-	modelLogs.insertRow(lastRow);
-	modelLogs.setData(modelLogs.index(lastRow, LOG_ID),         getNextID("Logs", "ID"));
-	modelLogs.setData(modelLogs.index(lastRow, LOG_TIME),       event.time.toString(dateTimeFormat));
-	modelLogs.setData(modelLogs.index(lastRow, LOG_CLIENT),     event.userName);
-	modelLogs.setData(modelLogs.index(lastRow, LOG_EVENT),      event.eventType);
-	modelLogs.setData(modelLogs.index(lastRow, LOG_PARAMETERS), event.parameters);
-	modelLogs.submitAll();
+	if(!persistence.shouldPersist(event))
+		return;
+
+	TraceSpan span("MainWnd::log");
+	QString project = UsersModel::getProject(event.userName);
+	if(shards.isSharded(project))
+		return shards.append(project, event);   // shown when written
+
+	QSqlQuery query;
+	query.prepare("insert into Logs values (?, ?, ?, ?, ?)");
+	query.addBindValue(getNextID("Logs", "ID"));
+	query.addBindValue(event.getTimeText());
+	query.addBindValue(event.userName);
+	query.addBindValue(event.eventType);
+	query.addBindValue(event.parameters);
+	if(!query.exec())
+		qDebug() << "Failed to log an event of" << event.userName;
+	if(logsProject.isEmpty())
+		refreshLogs();
+}
+
+// a lazy model on a connection of its own, as the shard's may be closed when idle
+void MainWnd::showLogs(const QString& project)
+{
+	ui.tvLogs->setModel(0);
+	delete modelLogs;
+	if(QSqlDatabase::contains("LogsView"))
+		QSqlDatabase::removeDatabase("LogsView");
+
+	QSqlDatabase database = QSqlDatabase::database();
+	if(!project.isEmpty())
+	{
+		database = QSqlDatabase::addDatabase("QSQLITE", "LogsView");
+		database.setDatabaseName(shards.getFileName(project));
+		database.open();
+	}
+	logsProject = project;
+	modelLogs = new QSqlTableModel(this, database);
+	modelLogs->setTable("Logs");
+	modelLogs->select();
+	ui.tvLogs->setModel(modelLogs);
+	ui.tvLogs->hideColumn(LOG_ID);
+	ui.tvLogs->sortByColumn(LOG_TIME, Qt::DescendingOrder);
 	ui.tvLogs->resizeColumnsToContents();
 }
 
-// broadcast packet to the group
-void MainWnd::broadcast(const QString& source, const QByteArray& packet) {
-	broadcast(source, getTeamMembers(source), packet);
+void MainWnd::onLogsChosen(int index) {
+	showLogs(ui.cbLogs->itemData(index).toString());
+}
+
+void MainWnd::refreshLogs()
+{
+	if(logsDirty)
+		return;
+	logsDirty = true;
+	QTimer::singleShot(1000, this, SLOT(onRefreshLogs()));
 }
 
-// broadcast event to the group
+// only the rows in view are fetched again
+void MainWnd::onRefreshLogs()
+{
+	logsDirty = false;
+	modelLogs->select();
+}
+
+// broadcast packet to the group, on this node and the others
+void MainWnd::broadcast(const QString& source, const QByteArray& packet)
+{
+	QString project = UsersModel::getProject(source);
+	broadcast(source, UsersModel::getProjectMembers(project), packet);
+	cluster.relayGroup(project, source, packet);
+}
+
+// broadcast event to the group, and log it
 void MainWnd::broadcast(const TeamRadarEvent& event)
 {
-	broadcast(event.userName, Sender::makeEventPacket(event));
+	relay(event);
 	log(event);
 }
 
+// send event to the group, on this node and the others
+void MainWnd::relay(const TeamRadarEvent& event)
+{
+	QString project = UsersModel::getProject(event.userName);
+	relayLocal(project, event);
+	cluster.relayEvent(project, event);
+}
+
+// filtered by the subscriptions of the recipients
+// the event is numbered, and kept in the ring of the project for resuming
+// each node numbers the events of its ring, so a client resumes on the node it was connected to
+void MainWnd::relayLocal(const QString& project, const TeamRadarEvent& event)
+{
+	EventRing& ring = getRing(project);
+	qint64 sequence = ring.nextSequence();
+	QByteArray packet = Sender::makeEventPacket(event, sequence);
+	ring.append(sequence, packet, event.userName, event.eventType);
+
+	int typeBit = Subscription::getTypeBit(event.eventType);
+	foreach(QString recipient, UsersModel::getProjectMembers(project))
+		if(Connection* connection = connectionPool.getConnection(recipient))
+		{
+			if(connection->accepts(event.userName, typeBit, event.eventType))
+				connection->getSender()->send(packet);
+		}
+}
+
 // broadcast packet from source to recipients
 void MainWnd::broadcast(const QString& source, const QList<QByteArray>& recipients, const QByteArray& packet)
 {
@@ -257,45 +503,63 @@ void MainWnd::onExport()
 	QFile file(fileName);
 	if(!file.open(QFile::WriteOnly | QFile::Truncate))
 		return;
-	QTextStream os(&file);
-	modelLogs.sort(LOG_TIME, Qt::AscendingOrder);
-	for(int i=0; i<modelLogs.rowCount(); ++i)
-		os << modelLogs.data(modelLogs.index(i, LOG_TIME))  .toString() << Connection::Delimiter1
-		   << modelLogs.data(modelLogs.index(i, LOG_CLIENT)).toString() << Connection::Delimiter1
-		   << modelLogs.data(modelLogs.index(i, LOG_EVENT)) .toString() << Connection::Delimiter1
-		   << modelLogs.data(modelLogs.index(i, LOG_PARAMETERS)).toString() << "\r\n";
-	modelLogs.sort(LOG_TIME, Qt::DescendingOrder);   // restore order
-}
 
-void MainWnd::onReqTeamMembers() {
-	if(Sender* sender = getSender())
+	// the main db and the shards, merged by time
+	QList<QSqlDatabase> databases;
+	databases << QSqlDatabase::database();
+	foreach(const QString& project, shards.getProjects())
+		databases << shards.getDatabase(project);
+
+	QStringList lines;
+	foreach(const QSqlDatabase& database, databases)
 	{
-		QList<QByteArray> allPeers = getTeamMembers(getSourceUserName());
-		sender->send(Sender::makeTeamMembersReply(allPeers));
-		log(TeamRadarEvent(sender->getUserName(), "Request all users"));
+		QSqlQuery query(database);
+		query.exec("select Time, Client, Event, Parameters from Logs");
+		while(query.next())
+			lines << query.value(0).toString() + Connection::Delimiter1 +
+					 query.value(1).toString() + Connection::Delimiter1 +
+					 query.value(2).toString() + Connection::Delimiter1 +
+					 query.value(3).toString();
 	}
+	qStableSort(lines.begin(), lines.end());   // the lines begin with the time
+
+	QTextStream os(&file);
+	foreach(const QString& line, lines)
+		os << line << "\r\n";
 }
 
-void MainWnd::onReqTimeSpan()
+void MainWnd::onReqTeamMembers(Connection* source)
 {
-	QSqlQuery query;
-	query.exec("select min(Time), max(Time) from Logs");
-	if(query.next())
-	{
-		QByteArray start = query.value(0).toString().toUtf8();
-		QByteArray end   = query.value(1).toString().toUtf8();
-		if(Sender* sender = getSender())
-			sender->send(Sender::makeTimeSpanReply(start, end));
-	}
+	QList<QByteArray> allPeers = getTeamMembers(source->getUserName());
+	foreach(const QString& member, cluster.getMembers(UsersModel::getProject(source->getUserName())))
+		if(!allPeers.contains(member.toUtf8()))   // online on another node only
+			allPeers << member.toUtf8();
+	source->getSender()->send(Sender::makeTeamMembersReply(allPeers));
+	log(TeamRadarEvent(source->getUserName(), "Request all users"));
 }
 
-void MainWnd::onReqProjects() {
-	if(Sender* sender = getSender())
-		sender->send(Sender::makeProjectsReply(UsersModel::getProjects()));
+void MainWnd::onReqTimeSpan(Connection* source)
+{
+	TimeSpanQuery* job = new TimeSpanQuery(source);
+	connect(job, SIGNAL(finished()), this, SLOT(onTimeSpanQueried()));
+	shards.submit(UsersModel::getProject(source->getUserName()), job);
 }
 
-void MainWnd::onRegPhoto(const QString& user, const QByteArray& photoData)
+void MainWnd::onTimeSpanQueried()
 {
+	TimeSpanQuery* job = qobject_cast<TimeSpanQuery*>(sender());
+	if(job != 0 && job->getConnection() != 0)
+		job->getConnection()->getSender()->send(
+					Sender::makeTimeSpanReply(job->getStart(), job->getEnd()));
+}
+
+void MainWnd::onReqProjects(Connection* source) {
+	source->getSender()->send(Sender::makeProjectsReply(UsersModel::getProjects()));
+}
+
+void MainWnd::onRegPhoto(Connection* source, const QByteArray& photoData)
+{
+	QString user = source->getUserName();
 	int seperator = photoData.indexOf(Connection::Delimiter1);
 	if(seperator == -1)
 		return;
@@ -309,6 +573,7 @@ void MainWnd::onRegPhoto(const QString& user, const QByteArray& photoData)
 		// save the file to disk and db
 		file.write(fileData);
 		UsersModel::setImage(user, fileName);
+		snapshots.setPhoto(user, fileData);
 		modelUsers.select();
 		log(TeamRadarEvent(user, "Register Photo"));
 
@@ -317,9 +582,11 @@ void MainWnd::onRegPhoto(const QString& user, const QByteArray& photoData)
 	}
 }
 
-void MainWnd::onRegColor(const QString& user, const QByteArray& color)
+void MainWnd::onRegColor(Connection* source, const QByteArray& color)
 {
+	QString user = source->getUserName();
 	UsersModel::setColor(user, color);
+	snapshots.setColor(user, color);
 	modelUsers.select();
 	log(TeamRadarEvent(user, "Register Color"));
 
@@ -327,24 +594,19 @@ void MainWnd::onRegColor(const QString& user, const QByteArray& color)
 	broadcast(user, Sender::makeColorReply(user, color));
 }
 
-void MainWnd::onReqOnline(const QString& targetUser) {
-	if(Sender* sender = getSender())
-	{
-		sender->send(Sender::makeOnlineReply(targetUser, UsersModel::isOnline(targetUser)));
-		log(TeamRadarEvent(sender->getUserName(), "Request online status of ", targetUser));
-	}
+void MainWnd::onReqOnline(Connection* source, const QString& targetUser)
+{
+	source->getSender()->send(replyOnline(targetUser));
+	log(TeamRadarEvent(source->getUserName(), "Request online status of", targetUser));
 }
 
-void MainWnd::onReqPhoto(const QString& targetUser)
+void MainWnd::onReqPhoto(Connection* source, const QString& targetUser)
 {
-	QString fileName = setting->getPhotoDir() + "/" + targetUser + ".png";
-	QFile file(fileName);
-	Sender* sender = getSender();
-	if(sender == 0)
-		return;
-	if(file.open(QFile::ReadOnly))
+	Sender* sender = source->getSender();
+	QByteArray reply = replyPhoto(targetUser);
+	if(!reply.isEmpty())
 	{
-		sender->send(Sender::makePhotoReply(fileName, file.readAll()));
+		sender->send(reply);
 		log(TeamRadarEvent(sender->getUserName(), "Request photo of", targetUser));
 	}
 	else {
@@ -352,113 +614,274 @@ void MainWnd::onReqPhoto(const QString& targetUser)
 	}
 }
 
-void MainWnd::onReqColor(const QString& targetUser)
+void MainWnd::onReqColor(Connection* source, const QString& targetUser)
 {
-	QByteArray color = UsersModel::getColor(targetUser).toUtf8();
-	if(Sender* sender = getSender())
+	source->getSender()->send(replyColor(targetUser));
+	log(TeamRadarEvent(source->getUserName(), "Request color of", targetUser));
+}
+
+// run the sub-requests in one pass, and send the replies in one write
+// the requests are distinct, see Receiver::parseReqBatch
+// the locations are queried on the worker threads, the batch is sent when all of them are done
+void MainWnd::onReqBatch(Connection* source, const QList<QByteArray>& requests)
+{
+	PendingBatch* batch = new PendingBatch;
+	batch->numWaiting = 0;
+
+	foreach(const QByteArray& request, requests)
+	{
+		// header;target user
+		int seperator = request.indexOf(Connection::Delimiter2);
+		if(seperator == -1)
+			continue;
+		// a batch costs what its sub-requests would have cost one by one
+		QByteArray header = request.left(seperator);
+		QString targetUser = QString::fromUtf8(request.mid(seperator + 1));
+		if(header == "REQ_PHOTO" && !source->getLimiter().acquire(RateLimiter::Photos))
+			batch->replies << Sender::makeBusyReply(header, "RATE_LIMITED");
+		else if(header == "REQ_LOCATION")   // its place in the batch is filled in onBatchLocationQueried()
+		{
+			LocationQuery* job = new LocationQuery(source, targetUser);
+			connect(job, SIGNAL(finished()), this, SLOT(onBatchLocationQueried()));
+			batchQueries.insert(job, qMakePair(batch, batch->replies.size()));
+			batch->replies << QByteArray();
+			++batch->numWaiting;
+			shards.submit(UsersModel::getProject(targetUser), job);
+		}
+		else if(BatchReplier replier = batchRepliers.value(header))
+			batch->replies << (this->*replier)(targetUser);
+	}
+	batch->numRequests = requests.size();
+
+	if(batch->numWaiting == 0)
 	{
-		sender->send(Sender::makeColorReply(targetUser, color));
-		log(TeamRadarEvent(sender->getUserName(), "Request color of", targetUser));
+		sendBatch(source, *batch);
+		delete batch;
 	}
 }
 
+void MainWnd::onBatchLocationQueried()
+{
+	LocationQuery* job = qobject_cast<LocationQuery*>(sender());
+	if(job == 0 || !batchQueries.contains(job))
+		return;
+
+	QPair<PendingBatch*, int> place = batchQueries.take(job);
+	PendingBatch* batch = place.first;
+	batch->replies[place.second] = makeLocationReply(job->getTargetUser(), job->getResult());
+	if(--batch->numWaiting > 0)
+		return;
+
+	// the jobs of a batch share the connection
+	if(job->getConnection() != 0)
+		sendBatch(job->getConnection(), *batch);
+	delete batch;
+}
+
+void MainWnd::sendBatch(Connection* connection, const PendingBatch& batch)
+{
+	Sender* sender = connection->getSender();
+	sender->send(batch.replies);   // nothing if none is answered
+	log(TeamRadarEvent(sender->getUserName(), "Request batch of", QString::number(batch.numRequests)));
+}
+
+QByteArray MainWnd::replyOnline(const QString& targetUser) {
+	return Sender::makeOnlineReply(targetUser, UsersModel::isOnline(targetUser) || cluster.isOnline(targetUser));
+}
+
+// empty if the photo is not available
+QByteArray MainWnd::replyPhoto(const QString& targetUser)
+{
+	QString fileName = setting->getPhotoDir() + "/" + targetUser + ".png";
+	QFile file(fileName);
+	return file.open(QFile::ReadOnly) ? Sender::makePhotoReply(fileName, file.readAll())
+									  : QByteArray();
+}
+
+QByteArray MainWnd::replyColor(const QString& targetUser) {
+	return Sender::makeColorReply(targetUser, UsersModel::getColor(targetUser).toUtf8());
+}
+
+// a SAVE event of the target user, empty if the user has not saved anything
+QByteArray MainWnd::makeLocationReply(const QString& targetUser, const QString& location) {
+	return location.isNull() ? QByteArray()
+							 : Sender::makeEventPacket(TeamRadarEvent(targetUser, "SAVE", location));
+}
+
 void MainWnd::resizeUserTable()
 {
 	ui.tvUsers->resizeRowsToContents();
 	ui.tvUsers->resizeColumnsToContents();
 }
 
-Events MainWnd::queryEvents(const QStringList& users, const QStringList& eventTypes,
-							const QDateTime& startTime, const QDateTime& endTime)
+// query on a worker thread, reply in onEventsQueried()
+// a reply is limited by the page size, and the server's row and byte budgets
+void MainWnd::onReqEvents(Connection* source, const QStringList& users, const QStringList& eventTypes,
+						  const QDateTime& startTime, const QDateTime& endTime,
+						  const QStringList& phases, int fuzziness,
+						  int pageSize, const QByteArray& token)
 {
-	// query without phases
-	QString userClause  = users     .isEmpty() ? "1" : tr("Client in (\"%1\")").arg(users     .join("\", \""));
-	QString eventClause = eventTypes.isEmpty() ? "1" : tr("Event  in (\"%1\")").arg(eventTypes.join("\", \""));
-	QString timeClause  = startTime.isNull() || endTime.isNull() ? "1"
-						: tr("Time between \"%1\" and \"%2\"").arg(startTime.toString(dateTimeFormat))
-															  .arg(endTime  .toString(dateTimeFormat));
-	QSqlQuery query;
-	query.exec(tr("select Client, Event, Parameters, Time from Logs \
-				  where %1 and %2 and %3 order by Time")
-			   .arg(userClause)
-			   .arg(eventClause)
-			   .arg(timeClause));
+	EventsQuery* job = new EventsQuery(source, users, eventTypes,
+									   startTime, endTime, phases, fuzziness);
+	job->setPage(pageSize, token, setting->getMaxEventsPerRequest(), setting->getMaxBytesPerRequest());
+	connect(job, SIGNAL(finished()), this, SLOT(onEventsQueried()));
+	shards.submit(UsersModel::getProject(source->getUserName()), job);
+}
+
+void MainWnd::onEventsQueried()
+{
+	EventsQuery* job = qobject_cast<EventsQuery*>(sender());
+	if(job == 0 || job->getConnection() == 0)
+		return;
 
-	Events result;
-	while(query.next())
-		result << TeamRadarEvent(query.value(0).toString(),
-								 query.value(1).toString(),
-								 query.value(2).toString(),
-								 query.value(3).toString());
-	return result;
+	Sender* sender = job->getConnection()->getSender();
+	foreach(const QByteArray& packet, job->getResult())
+		sender->send(packet);
+	if(job->isPaged())
+		sender->send(Sender::makeEventsPageEnd(job->getNextToken()));
 }
 
-void MainWnd::onReqEvents(const QStringList& users, const QStringList& eventTypes,
-							  const QDateTime& startTime, const QDateTime& endTime,
-							  const QStringList& phases, int fuzziness)
+// users who worked under the path prefix, most recent first
+void MainWnd::onReqFileActivity(Connection* source, const QString& prefix, int maxResults)
 {
-	// query without phases
-	Events events = queryEvents(users, eventTypes, startTime, endTime);
+	Sender* sender = source->getSender();
+	typedef QPair<uint, QByteArray> Row;   // last time, row
+	QList<Row> rows;
+	PathIndex::Users users = pathIndex.find(UsersModel::getProject(sender->getUserName()), prefix);
+	for(PathIndex::Users::ConstIterator it = users.begin(); it != users.end(); ++it)
+		rows << Row(it.value().lastTime,
+					it.key().toUtf8() + Connection::Delimiter2 +
+					QDateTime::fromTime_t(it.value().lastTime).toString(dateTimeFormat).toUtf8() +
+					Connection::Delimiter2 + QByteArray::number(it.value().count));
+	qSort(rows.begin(), rows.end(), qGreater<Row>());
 
-	// filter by phases
-	PhaseDivider divider(events, fuzziness);
-	Events dividedEvents = divider.getEvents(phases);
+	QList<QByteArray> result;
+	for(int i = 0; i < rows.size() && (maxResults <= 0 || i < maxResults); ++i)
+		result << rows.at(i).second;
+	sender->send(Sender::makeFileActivityReply(prefix, result));
+}
 
-	// send
-	if(Sender* sender = getSender())
-		foreach(TeamRadarEvent event, dividedEvents)
-			sender->send(Sender::makeEventsReply(event));
+void MainWnd::onSavePathIndex() {
+	pathIndex.save(pathIndexFileName);
+}
+
+// counts from the rollups of the requester's project
+void MainWnd::onReqActivity(Connection* source, const QDateTime& startTime, const QDateTime& endTime,
+							const QString& resolution,
+							const QStringList& users, const QStringList& eventTypes)
+{
+	rollup.flush();   // include the recent events
+	ActivityQuery* job = new ActivityQuery(source, UsersModel::getProject(source->getUserName()),
+										   startTime, endTime, resolution, users, eventTypes);
+	connect(job, SIGNAL(finished()), this, SLOT(onActivityQueried()));
+	executor.submit(job);
 }
 
-void MainWnd::onChat(const QList<QByteArray>& recipients, const QByteArray& content)
+void MainWnd::onActivityQueried()
 {
-	QString sourceName = getSourceUserName();
-	broadcast(sourceName, recipients, Sender::makeChatPacket(sourceName, content));
+	ActivityQuery* job = qobject_cast<ActivityQuery*>(sender());
+	if(job != 0 && job->getConnection() != 0)
+		job->getConnection()->getSender()->send(Sender::makeActivityReply(job->getResult()));
+}
+
+void MainWnd::onChat(Connection* source, const QList<QByteArray>& recipients, const QByteArray& content)
+{
+	QString sourceName = source->getUserName();
+	QByteArray packet = Sender::makeChatPacket(sourceName, content);
+	broadcast(sourceName, recipients, packet);
+	cluster.deliver(recipients, sourceName, packet);
+}
+
+// an event of a user on another node
+void MainWnd::onClusterEvent(const QString& project, const TeamRadarEvent& event) {
+	relayLocal(project, event);
+}
+
+void MainWnd::onClusterGroup(const QString& project, const QString& source, const QByteArray& packet) {
+	broadcast(source, UsersModel::getProjectMembers(project), packet);
+}
+
+void MainWnd::onClusterDeliver(const QList<QByteArray>& recipients, const QString& source, const QByteArray& packet) {
+	broadcast(source, recipients, packet);
 }
 
-void MainWnd::onJointProject(const QString& projectName)
+void MainWnd::onJoinProject(Connection* source, const QString& projectName)
 {
 	// remove the developer from the old group
-	QString developer = getSourceUserName();
+	QString developer = source->getUserName();
 	QString oldProject = UsersModel::getProject(developer);
 	if(!oldProject.isEmpty() && oldProject != projectName)
 		broadcast(TeamRadarEvent(developer, "DISCONNECTED", oldProject));
 
 	UsersModel::setProject(developer, projectName);
+	snapshots.setProject(developer, projectName);
+	cluster.join(developer, projectName);
 	modelUsers.select();
 	broadcast(TeamRadarEvent(developer, "JOINED", projectName));
 }
 
 // send a SAVE event to update the client's display of targetUser's location
-void MainWnd::onReqLocation(const QString& targetUser)
+void MainWnd::onReqLocation(Connection* source, const QString& targetUser)
 {
-	// find the last SAVE event
-	QSqlQuery query;
-	query.exec(tr("select Parameters from Logs where Client = \"%1\" \
-				  and Event = \"SAVE\" order by Time desc").arg(targetUser));
-	if(query.next()) {
-		if(Sender* sender = getSender())
-		{
-			sender->send(Sender::makeEventPacket(
-							 TeamRadarEvent(targetUser, "SAVE", query.value(0).toString())));
-			log(TeamRadarEvent(sender->getUserName(), "Request location of", targetUser));
-		}
+	LocationQuery* job = new LocationQuery(source, targetUser);
+	connect(job, SIGNAL(finished()), this, SLOT(onLocationQueried()));
+	shards.submit(UsersModel::getProject(targetUser), job);
+}
+
+void MainWnd::onLocationQueried()
+{
+	LocationQuery* job = qobject_cast<LocationQuery*>(sender());
+	if(job == 0 || job->getConnection() == 0)
+		return;
+
+	QByteArray reply = makeLocationReply(job->getTargetUser(), job->getResult());
+	if(!reply.isEmpty())
+	{
+		Sender* sender = job->getConnection()->getSender();
+		sender->send(reply);
+		log(TeamRadarEvent(sender->getUserName(), "Request location of", job->getTargetUser()));
 	}
 }
 
-Sender* MainWnd::getSender() const
+// the state of the whole team in one reply
+void MainWnd::onReqSnapshot(Connection* source) {
+	source->getSender()->send(snapshots.getSnapshot(UsersModel::getProject(source->getUserName())));
+}
+
+EventRing& MainWnd::getRing(const QString& project)
 {
-	Receiver* receiver = qobject_cast<Receiver*>(sender());
-	return receiver != 0 ? receiver->getSender() : 0;
+	QHash<QString, EventRing>::Iterator it = rings.find(project);
+	if(it == rings.end())
+		it = rings.insert(project, EventRing(setting->getResumeRingSize()));
+	return it.value();
 }
 
-QString MainWnd::getSourceUserName() const
+// replay from memory the events missed since the last sequence the client has seen
+void MainWnd::resume(Connection* connection)
 {
-	Receiver* receiver = qobject_cast<Receiver*>(sender());
-	return receiver != 0 ? receiver->getUserName() : QString();
+	QString project = UsersModel::getProject(connection->getUserName());
+	QHash<QString, EventRing>::ConstIterator it = rings.find(project);
+	QList<EventRing::Entry> missed;
+	bool resumed = it != rings.end() && it.value().getSince(connection->getResumeSequence(), missed);
+	qint64 last  = it != rings.end() ? it.value().lastSequence() : -1;
+
+	// the same stream as it would have been relayed
+	Sender* sender = connection->getSender();
+	sender->send(Sender::makeResumeReply(resumed, last));
+	int count = 0;
+	foreach(const EventRing::Entry& entry, missed)
+		if(connection->accepts(entry.source, Subscription::getTypeBit(entry.eventType), entry.eventType))
+		{
+			sender->send(entry.packet);
+			++count;
+		}
+	log(TeamRadarEvent(connection->getUserName(), resumed ? "Resumed" : "Failed: Resume",
+					   QString::number(count)));
 }
 
-QList<QByteArray> MainWnd::getTeamMembers(const QString& user) const {
+QList<QByteArray> MainWnd::getTeamMembers(const QString& user) const
+{
+	TraceSpan span("MainWnd::getTeamMembers");
 	return UsersModel::getProjectMembers(UsersModel::getProject(user));
 }
 
@@ -505,7 +928,8 @@ void MainWnd::onClearLog()
 	{
 		QSqlQuery query;
 		query.exec("delete from Logs");
-		modelLogs.select();
+		shards.execAll("delete from Logs");
+		modelLogs->select();
 	}
 }
 
@@ -519,6 +943,7 @@ void MainWnd::onDelUser()
 	qSort(indexes.begin(), indexes.end(), qGreater<QModelIndex>());
 	foreach(const QModelIndex& idx, indexes)
 		modelUsers.removeRow(idx.row());
+	snapshots.clear();
 }
 
 void MainWnd::onDelLogs()
@@ -530,10 +955,26 @@ void MainWnd::onDelLogs()
 	QModelIndexList indexes = ui.tvLogs->selectionModel()->selectedRows();
 	qSort(indexes.begin(), indexes.end(), qGreater<QModelIndex>());
 	foreach(const QModelIndex& idx, indexes)   // delete selected
-		modelLogs.removeRow(idx.row());
+		modelLogs->removeRow(idx.row());
+}
+
+// the events of its members are not in the main db any more
+void MainWnd::onShardCreated(const QString& project)
+{
+	if(ui.cbLogs->findData(project) < 0)
+		ui.cbLogs->addItem(project, project);
+	if(logsProject.isEmpty())
+		refreshLogs();
+}
+
+void MainWnd::onShardWritten(const QString& project)
+{
+	if(project == logsProject)
+		refreshLogs();
 }
 
 const QString MainWnd::dateTimeFormat = "yyyy-MM-dd HH:mm:ss";
+const QString MainWnd::pathIndexFileName = "PathIndex.dat";
 
 int getNextID(const QString& tableName, const QString& sectionName)
 {
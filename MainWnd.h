@@ -6,18 +6,30 @@
 #include <QMultiHash>
 #include <QHostAddress>
 #include <QList>
+#include <QMap>
 #include <QSqlTableModel>
 #include "ui_MainWnd.h"
 #include "Server.h"
 #include "UsersModel.h"
 #include "TeamRadarEvent.h"
 #include "ConnectionPool.h"
+#include "SnapshotCache.h"
+#include "EventRing.h"
+#include "EventCoalescer.h"
+#include "PersistencePolicy.h"
+#include "QueryExecutor.h"
+#include "ActivityRollup.h"
+#include "PathIndex.h"
+#include "LogShards.h"
+#include "CommandHandler.h"
+#include "LoadMonitor.h"
+#include "Cluster.h"
 
 struct TeamRadarEvent;
 class Setting;
 class Sender;
 
-class MainWnd : public QDialog
+class MainWnd : public QDialog, public CommandHandler
 {
 	Q_OBJECT
 
@@ -33,58 +45,101 @@ private slots:
 	void onShutdown();
 	void onTrayActivated(QSystemTrayIcon::ActivationReason reason);
 	void onAbout();
+	void onTrace(bool enable);
+	void onUpdateStatistics();
 	void onExport();
 	void onClearLog();
 	void onDelUser();
 	void onDelLogs();
+	void onShardCreated(const QString& project);
+	void onShardWritten(const QString& project);
+	void onLogsChosen(int index);
+	void onRefreshLogs();
 	void resizeUserTable();
 
-	// Connection
 	void onPortChanged(int port);
-	void onNewConnection(Connection* connection);
-	void onDisconnected();
-	void onReadyForUse();
-	void onChangeName(const QString& oldName, const QString& newName);
-
-	// events
-	void onNewEvent(const QString& user, const QByteArray& message);
-	void onRegPhoto(const QString& user, const QByteArray& photoData);
-	void onRegColor(const QString& user, const QByteArray& color);
-	void onChat(const QList<QByteArray>& recipients, const QByteArray& content);
-	void onJointProject(const QString& projectName);
-	void onReqTeamMembers();
-	void onReqTimeSpan();
-	void onReqProjects();
-	void onReqOnline  (const QString& targetUser);
-	void onReqPhoto   (const QString& targetUser);
-	void onReqColor   (const QString& targetUser);
-	void onReqLocation(const QString& targetUser);
-	void onReqEvents  (const QStringList& users, const QStringList& eventTypes,
+	void onCoalesced(const TeamRadarEvent& event);
+	void onSavePathIndex();
+
+	// from the other nodes of the cluster
+	void onClusterEvent  (const QString& project, const TeamRadarEvent& event);
+	void onClusterGroup  (const QString& project, const QString& source, const QByteArray& packet);
+	void onClusterDeliver(const QList<QByteArray>& recipients, const QString& source, const QByteArray& packet);
+
+	// completion of the queries
+	void onActivityQueried();
+	void onEventsQueried();
+	void onLocationQueried();
+	void onBatchLocationQueried();
+	void onTimeSpanQueried();
+
+private:
+	// CommandHandler, called by the Receivers of the connections
+	void onReadyForUse (Connection* source);
+	void onDisconnected(Connection* source);
+	void onChangeName  (Connection* source, const QString& oldName, const QString& newName);
+	void onNewEvent   (Connection* source, const QByteArray& message);
+	void onRegPhoto   (Connection* source, const QByteArray& photoData);
+	void onRegColor   (Connection* source, const QByteArray& color);
+	void onChat       (Connection* source, const QList<QByteArray>& recipients, const QByteArray& content);
+	void onJoinProject(Connection* source, const QString& projectName);
+	void onReqTeamMembers(Connection* source);
+	void onReqTimeSpan   (Connection* source);
+	void onReqProjects   (Connection* source);
+	void onReqSnapshot   (Connection* source);
+	void onReqOnline  (Connection* source, const QString& targetUser);
+	void onReqPhoto   (Connection* source, const QString& targetUser);
+	void onReqColor   (Connection* source, const QString& targetUser);
+	void onReqLocation(Connection* source, const QString& targetUser);
+	void onReqBatch   (Connection* source, const QList<QByteArray>& requests);
+	void onReqEvents  (Connection* source, const QStringList& users, const QStringList& eventTypes,
 					   const QDateTime& startTime, const QDateTime& endTime,
-					   const QStringList& phases, int fuzziness);
+					   const QStringList& phases, int fuzziness,
+					   int pageSize, const QByteArray& token);
+	void onReqActivity(Connection* source, const QDateTime& startTime, const QDateTime& endTime,
+					   const QString& resolution,
+					   const QStringList& users, const QStringList& eventTypes);
+	void onReqFileActivity(Connection* source, const QString& prefix, int maxResults);
 
 private:
 	void createTray();
+	void startCapture();
 	void updateLocalAddresses();        // find local IPs
-	Sender* getSender() const;          // sender of the connection responsible for the current signal
-	QString getSourceUserName() const;  // user name of the connection responsible for the current signal
 	QList<QByteArray> getTeamMembers(const QString& user) const;   // all members on the same project
+	EventRing& getRing(const QString& project);
+	void resume(Connection* connection);   // replay the missed events
 
 	void broadcast(const QString& source, const QList<QByteArray>& recipients,
 				   const QByteArray& packet);                          // to specific recipients (when chatting)
 	void broadcast(const QString& source, const QByteArray& packet);   // to the group
-	void broadcast(const TeamRadarEvent& event);                       // for convenience, to the group
+	void broadcast(const TeamRadarEvent& event);                       // for convenience, to the group, and log
+	void relay    (const TeamRadarEvent& event);                       // to the group, without logging
+	void relayLocal(const QString& project, const TeamRadarEvent& event);   // to the members on this node
 	void log      (const TeamRadarEvent& event);
-	Events queryEvents(const QStringList& users      = QStringList(),
-					   const QStringList& eventTypes = QStringList(),
-					   const QDateTime&   startTime  = QDateTime(),
-					   const QDateTime&   endTime    = QDateTime());
+	void showLogs(const QString& project);   // of the main db if empty, or of the shard of the project
+	void refreshLogs();                      // soon, once for many events
+	// replies to the requests about a target user, shared by REQ_BATCH
+	QByteArray replyOnline  (const QString& targetUser);
+	QByteArray replyPhoto   (const QString& targetUser);
+	QByteArray replyColor   (const QString& targetUser);
+	static QByteArray makeLocationReply(const QString& targetUser, const QString& location);
+
+	// a REQ_BATCH waiting for its location queries
+	struct PendingBatch
+	{
+		QList<QByteArray> replies;   // in the order of the sub-requests, empty if not answered
+		int numRequests;             // sub-requests
+		int numWaiting;              // location queries not finished yet
+	};
+	void sendBatch(Connection* connection, const PendingBatch& batch);   // in one write
+
 	void contextMenuLogs (const QPoint& mousePosition);
 	void contextMenuUsers(const QPoint& mousePosition);
 
 public:
 	enum {LOG_ID, LOG_TIME, LOG_CLIENT, LOG_EVENT, LOG_PARAMETERS};  // for the log model
 	static const QString dateTimeFormat;
+	static const QString pathIndexFileName;
 
 private:
 	Ui::MainWndClass ui;
@@ -93,7 +148,23 @@ private:
 	QSystemTrayIcon* trayIcon;
 	Server           server;
 	ConnectionPool   connectionPool;
-	QSqlTableModel   modelLogs;
+	SnapshotCache    snapshots;
+	QHash<QString, EventRing> rings;   // project -> recent events
+	EventCoalescer   coalescer;
+	PersistencePolicy persistence;
+	QueryExecutor    executor;
+	LogShards        shards;
+	ActivityRollup   rollup;
+	PathIndex        pathIndex;
+	LoadMonitor      loadMonitor;
+	Cluster          cluster;
+
+	typedef QByteArray (MainWnd::*BatchReplier)(const QString& targetUser);
+	QMap<QByteArray, BatchReplier> batchRepliers;   // sub-request header -> replier
+	QHash<QObject*, QPair<PendingBatch*, int> > batchQueries;   // location query -> its batch & place
+	QSqlTableModel*  modelLogs;     // of the db chosen on the Logs tab
+	QString          logsProject;   // of the shard shown, empty for the main db
+	bool             logsDirty;     // a refresh is scheduled
 	UsersModel       modelUsers;
 
 };
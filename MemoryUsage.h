@@ -0,0 +1,25 @@
+#ifndef MemoryUsage_h__
+#define MemoryUsage_h__
+
+#include <QtGlobal>
+
+// Approximate bytes held by connections, for the memory budget
+struct MemoryUsage
+{
+	MemoryUsage() : buffers(0), output(0), objects(0) {}
+	qint64 getTotal() const { return buffers + output + objects; }
+
+	MemoryUsage& operator+=(const MemoryUsage& other)
+	{
+		buffers += other.buffers;
+		output  += other.output;
+		objects += other.objects;
+		return *this;
+	}
+
+	qint64 buffers;   // received, not processed yet
+	qint64 output;    // queued for sending
+	qint64 objects;   // the connection, its socket, and their state
+};
+
+#endif // MemoryUsage_h__
@@ -0,0 +1,109 @@
+#include "Outbox.h"
+#include "Connection.h"
+
+int    Outbox::chunkSize = 16 * 1024;
+qint64 Outbox::numChunks = 0;
+
+namespace {
+
+// the replies to the bulk requests, see Receiver::isBulk
+const char* bulkHeaders[] = {
+	"PHOTO_REPLY",
+	"EVENTS_REPLY",
+	"EVENTS_PAGE_END",
+	"ACTIVITY_REPLY",
+	"FILE_ACTIVITY_REPLY"
+};
+
+}
+
+Outbox::Outbox(Connection* c)
+	: connection(c), numBytesQueued(0), interactiveRun(0), chunked(false) {}
+
+Outbox::Lane Outbox::getLane(const QByteArray& packet)
+{
+	int headerSize = packet.indexOf(Connection::Delimiter1);
+	for(int i = 0; i < int(sizeof(bulkHeaders) / sizeof(bulkHeaders[0])); ++i)
+		if(int(qstrlen(bulkHeaders[i])) == headerSize && qstrncmp(bulkHeaders[i], packet.constData(), headerSize) == 0)
+			return Bulk;
+	return Interactive;
+}
+
+void Outbox::push(const QByteArray& packet) {
+	push(packet, getLane(packet), Sender::shouldCompress(packet));
+}
+
+void Outbox::push(const QByteArray& packet, Lane lane, bool compress)
+{
+	Entry entry;
+	entry.packet   = packet;
+	entry.offset   = 0;
+	entry.compress = compress;
+	lanes[lane].enqueue(entry);
+	numBytesQueued += packet.size();
+	pump();
+}
+
+void Outbox::pump()
+{
+	while(connection->getNumBytesToWrite() < Watermark && writeNext()) {}
+}
+
+void Outbox::clear()
+{
+	for(int lane = 0; lane < NumLanes; ++lane)
+		lanes[lane].clear();
+	numBytesQueued = 0;
+	interactiveRun = 0;
+}
+
+// interactive first, but bulk is not starved by a steady stream of events
+bool Outbox::writeNext()
+{
+	bool interactive = !lanes[Interactive].isEmpty() &&
+					   (lanes[Bulk].isEmpty() || interactiveRun < BulkShare * qMax(chunkSize, int(Watermark)));
+	Lane lane = interactive ? Interactive : Bulk;
+	QQueue<Entry>& queue = lanes[lane];
+	if(queue.isEmpty())
+		return false;
+
+	Entry& entry = queue.head();
+	int size = entry.packet.size() - entry.offset;
+	if(chunked && chunkSize > 0 && (entry.offset > 0 || size > chunkSize))
+	{
+		size = qMin(size, chunkSize);
+		bool more = entry.offset + size < entry.packet.size();
+		write(Sender::makeChunk(lane, more, entry.packet.constData() + entry.offset, size), entry.compress);
+		++numChunks;
+	}
+	else
+		write(entry.packet, entry.compress);
+
+	entry.offset   += size;
+	numBytesQueued -= size;
+	if(entry.offset == entry.packet.size())
+		queue.dequeue();
+
+	if(interactive && !lanes[Bulk].isEmpty())
+		interactiveRun += size;
+	else if(!interactive)
+		interactiveRun = 0;
+	return true;
+}
+
+// compressed in the order written, as the client inflates
+void Outbox::write(const QByteArray& data, bool compress)
+{
+	Compressor* compressor = connection->getCompressor();
+	if(compressor != 0 && compress)
+	{
+		QByteArray deflated = compressor->compress(data);
+		if(!deflated.isEmpty())
+		{
+			connection->write(Sender::makePacket("Z", deflated));
+			return;
+		}
+		connection->setCompression(false);   // deflate failed; the packets sent before are complete
+	}
+	connection->write(data);
+}
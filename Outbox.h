@@ -0,0 +1,63 @@
+#ifndef Outbox_h__
+#define Outbox_h__
+
+#include <QByteArray>
+#include <QQueue>
+
+class Connection;
+
+// The outbound packets of a connection, on two lanes
+// Interactive: live events, chat and the small replies; Bulk: history and photos
+// The socket is handed a little at a time, so that an interactive packet waits behind
+// at most one chunk of bulk data, instead of all that was sent before it
+// Large packets are split into chunks for the clients accepting them (CHUNKED at GREETING)
+// Format of chunk: CHUNK#size#lane#more#part of the packet
+//   the parts of a lane are concatenated until more is 0, and then parsed as a packet
+//   the lanes do not interleave within themselves, so a client needs one buffer for each
+class Outbox
+{
+public:
+	typedef enum {Interactive, Bulk, NumLanes} Lane;
+
+	Outbox(Connection* c);
+	void push(const QByteArray& packet);   // and write what the socket has room for
+	void push(const QByteArray& packet, Lane lane, bool compress);   // decided by the caller
+	void pump();                           // as the socket drains
+	void clear();
+	bool isEmpty() const { return numBytesQueued == 0; }
+	qint64 getNumBytesQueued() const { return numBytesQueued; }
+	void setChunked(bool enable) { chunked = enable; }
+	bool isChunked() const { return chunked; }
+
+	static Lane getLane(const QByteArray& packet);   // by header
+	static void setChunkSize(int size) { chunkSize = size; }   // 0 for not offering chunking
+	static int  getChunkSize() { return chunkSize; }
+	static bool isEnabled() { return chunkSize > 0; }
+
+	static qint64 getNumChunks() { return numChunks; }   // of all connections
+
+private:
+	struct Entry
+	{
+		QByteArray packet;
+		int        offset;     // sent so far, in chunks
+		bool       compress;   // on a connection with compression, see Sender::shouldCompress
+	};
+
+	bool writeNext();   // a packet or a chunk, false if none is queued
+	void write(const QByteArray& data, bool compress);
+
+private:
+	Connection*   connection;
+	QQueue<Entry> lanes[NumLanes];
+	qint64        numBytesQueued;
+	int           interactiveRun;   // bytes sent on the interactive lane while bulk waits
+	bool          chunked;
+
+	static const int Watermark   = 16 * 1024;   // the most buffered in the socket before giving it more
+	static const int BulkShare   = 4;           // a bulk unit after this many chunks of interactive data
+	static int    chunkSize;
+	static qint64 numChunks;
+};
+
+#endif // Outbox_h__
@@ -0,0 +1,75 @@
+#include "PacketRecorder.h"
+
+PacketRecorder::PacketRecorder(const QString& fileName) : file(fileName)
+{
+	if(file.open(QFile::WriteOnly | QFile::Truncate))
+	{
+		os.setDevice(&file);
+		os.setVersion(QDataStream::Qt_4_6);
+		os << Magic << Version;
+	}
+	timer.start();
+}
+
+bool PacketRecorder::start(const QString& fileName)
+{
+	stop();
+	instance = new PacketRecorder(fileName);
+	if(!instance->file.isOpen())
+	{
+		delete instance;
+		instance = 0;
+		return false;
+	}
+	return true;
+}
+
+void PacketRecorder::stop()
+{
+	delete instance;   // file closed & flushed by QFile
+	instance = 0;
+}
+
+void PacketRecorder::write(quint8 type, quint32 connectionID, const QByteArray& data)
+{
+	os << type << connectionID << quint32(timer.elapsed());
+	if(type == CaptureRecord::Data)
+		os << data;
+}
+
+void PacketRecorder::recordOpen(quint32 connectionID) {
+	if(instance != 0)
+		instance->write(CaptureRecord::Open, connectionID);
+}
+
+void PacketRecorder::recordData(quint32 connectionID, const QByteArray& data) {
+	if(instance != 0 && !data.isEmpty())
+		instance->write(CaptureRecord::Data, connectionID, data);
+}
+
+void PacketRecorder::recordClose(quint32 connectionID) {
+	if(instance != 0)
+		instance->write(CaptureRecord::Close, connectionID);
+}
+
+bool PacketRecorder::readHeader(QDataStream& is)
+{
+	is.setVersion(QDataStream::Qt_4_6);
+	quint32 magic;
+	quint16 version;
+	is >> magic >> version;
+	return is.status() == QDataStream::Ok && magic == Magic && version == Version;
+}
+
+bool PacketRecorder::readRecord(QDataStream& is, CaptureRecord& record)
+{
+	if(is.atEnd())
+		return false;
+	is >> record.type >> record.connectionID >> record.time;
+	record.data.clear();
+	if(record.type == CaptureRecord::Data)
+		is >> record.data;
+	return is.status() == QDataStream::Ok;
+}
+
+PacketRecorder* PacketRecorder::instance = 0;
@@ -0,0 +1,54 @@
+#ifndef PacketRecorder_h__
+#define PacketRecorder_h__
+
+#include <QFile>
+#include <QDataStream>
+#include <QElapsedTimer>
+
+// A record of the capture file
+// Format of file: magic#version, then records
+// Format of record: type, connection id, msecs since capture start, [data]
+struct CaptureRecord
+{
+	typedef enum {Open, Data, Close} Type;
+
+	quint8     type;
+	quint32    connectionID;
+	quint32    time;       // msecs since the start of the capture
+	QByteArray data;       // raw inbound bytes, for Data only
+};
+
+// Writes raw, timestamped inbound byte streams of all connections to a capture file
+// Replayed by tools/replay
+class PacketRecorder
+{
+public:
+	static bool start(const QString& fileName);
+	static void stop();
+	static bool isRecording() { return instance != 0; }
+
+	static void recordOpen (quint32 connectionID);
+	static void recordData (quint32 connectionID, const QByteArray& data);
+	static void recordClose(quint32 connectionID);
+
+	// for the reader
+	static bool readHeader(QDataStream& is);
+	static bool readRecord(QDataStream& is, CaptureRecord& record);
+
+private:
+	PacketRecorder(const QString& fileName);
+	void write(quint8 type, quint32 connectionID, const QByteArray& data = QByteArray());
+
+public:
+	static const quint32 Magic   = 0x54524350;   // "TRCP"
+	static const quint16 Version = 1;
+
+private:
+	QFile         file;
+	QDataStream   os;
+	QElapsedTimer timer;
+
+	static PacketRecorder* instance;
+};
+
+#endif // PacketRecorder_h__
@@ -0,0 +1,179 @@
+#include "PathIndex.h"
+#include "MainWnd.h"
+#include <QFile>
+#include <QDataStream>
+#include <QSqlQuery>
+#include <QVariant>
+
+// a/b\c/ -> a/b/c
+QString PathIndex::normalize(const QString& path)
+{
+	QString result = path;
+	result.replace('\\', '/');
+	return result.split('/', QString::SkipEmptyParts).join("/");
+}
+
+void PathIndex::add(const QString& project, const QString& user, const QString& path,
+					const QDateTime& time) {
+	add(project, user, normalize(path), time.toTime_t(), 1);
+}
+
+void PathIndex::add(const QString& project, const QString& user, const QString& path,
+					uint time, quint32 count)
+{
+	if(path.isEmpty())
+		return;
+	dirty  = true;
+	latest = qMax(latest, time);
+	Entry& file = files[Key(project, path)][user];
+	file.lastTime = qMax(file.lastTime, time);
+	file.count   += count;
+
+	// the file and its ancestors
+	QString prefix;
+	foreach(const QString& component, path.split('/'))
+	{
+		prefix += prefix.isEmpty() ? component : "/" + component;
+		Entry& entry = prefixes[Key(project, prefix)][user];
+		entry.lastTime = qMax(entry.lastTime, time);
+		entry.count   += count;
+	}
+}
+
+void PathIndex::rename(const QString& oldName, const QString& newName)
+{
+	rename(prefixes, oldName, newName);
+	rename(files,    oldName, newName);
+	dirty = true;
+}
+
+void PathIndex::rename(QHash<Key, Users>& index, const QString& oldName, const QString& newName)
+{
+	for(QHash<Key, Users>::Iterator it = index.begin(); it != index.end(); ++it)
+	{
+		Users& users = it.value();
+		if(!users.contains(oldName))
+			continue;
+		Entry oldEntry = users.take(oldName);
+		Entry& entry = users[newName];
+		entry.lastTime = qMax(entry.lastTime, oldEntry.lastTime);
+		entry.count   += oldEntry.count;
+	}
+}
+
+PathIndex::Users PathIndex::find(const QString& project, const QString& prefix) const {
+	return prefixes.value(Key(project, normalize(prefix)));
+}
+
+QDateTime PathIndex::getLatest() const {
+	return latest == 0 ? QDateTime() : QDateTime::fromTime_t(latest);
+}
+
+void PathIndex::clear()
+{
+	prefixes.clear();
+	files.clear();
+	latest = 0;
+	dirty  = false;
+}
+
+// Format of file: Magic, number of files, then for each: project, path, number of users,
+// then user, last time, count
+// a broken file is discarded as a whole, for a backfill from scratch
+bool PathIndex::load(const QString& fileName)
+{
+	clear();
+	QFile file(fileName);
+	if(!file.open(QFile::ReadOnly))
+		return false;
+
+	QDataStream is(&file);
+	is.setVersion(QDataStream::Qt_4_6);
+	quint32 magic, numFiles;
+	is >> magic >> numFiles;
+	if(magic != Magic)
+		return false;
+	for(quint32 i = 0; i < numFiles && is.status() == QDataStream::Ok; ++i)
+	{
+		QString project, path;
+		quint32 numUsers;
+		is >> project >> path >> numUsers;
+		for(quint32 j = 0; j < numUsers && is.status() == QDataStream::Ok; ++j)
+		{
+			QString user;
+			Entry   entry;
+			is >> user >> entry.lastTime >> entry.count;
+			add(project, user, path, entry.lastTime, entry.count);
+		}
+	}
+	if(is.status() != QDataStream::Ok)
+	{
+		clear();
+		return false;
+	}
+	dirty = false;
+	return true;
+}
+
+// into a temp file first, so that a crash while writing leaves the old file intact
+bool PathIndex::save(const QString& fileName)
+{
+	if(!dirty)
+		return true;
+
+	QString tempName = fileName + ".tmp";
+	QFile file(tempName);
+	if(!file.open(QFile::WriteOnly | QFile::Truncate))
+		return false;
+
+	QDataStream os(&file);
+	os.setVersion(QDataStream::Qt_4_6);
+	os << Magic << quint32(files.size());
+	for(QHash<Key, Users>::ConstIterator file = files.begin(); file != files.end(); ++file)
+	{
+		const Users& users = file.value();
+		os << file.key().first << file.key().second << quint32(users.size());
+		for(Users::ConstIterator it = users.begin(); it != users.end(); ++it)
+			os << it.key() << it.value().lastTime << it.value().count;
+	}
+	file.close();
+	if(os.status() != QDataStream::Ok || file.error() != QFile::NoError)
+	{
+		QFile::remove(tempName);
+		return false;
+	}
+
+	// QFile::rename does not overwrite
+	QFile::remove(fileName);
+	if(!QFile::rename(tempName, fileName))
+		return false;
+	dirty = false;
+	return true;
+}
+
+// the projects are the current ones of the users
+void PathIndex::backfill(const QDateTime& after)
+{
+	QSqlQuery query;
+	query.exec(QObject::tr("select Project, Client, Parameters, max(Time), count(*) from Logs \
+						   join Users on Client = Username where Event = \"SAVE\" and Time > \"%1\" \
+						   group by Project, Client, Parameters")
+			   .arg(after.toString(MainWnd::dateTimeFormat)));
+	while(query.next())
+		add(query.value(0).toString(), query.value(1).toString(),
+			normalize(query.value(2).toString()),
+			QDateTime::fromString(query.value(3).toString(), MainWnd::dateTimeFormat).toTime_t(),
+			query.value(4).toUInt());
+}
+
+void PathIndex::backfill(QSqlDatabase database, const QString& project, const QDateTime& after)
+{
+	QSqlQuery query(database);
+	query.exec(QObject::tr("select Client, Parameters, max(Time), count(*) from Logs \
+						   where Event = \"SAVE\" and Time > \"%1\" group by Client, Parameters")
+			   .arg(after.toString(MainWnd::dateTimeFormat)));
+	while(query.next())
+		add(project, query.value(0).toString(), normalize(query.value(1).toString()),
+			QDateTime::fromString(query.value(2).toString(), MainWnd::dateTimeFormat).toTime_t(),
+			query.value(3).toUInt());
+}
@@ -0,0 +1,61 @@
+#ifndef PathIndex_h__
+#define PathIndex_h__
+
+#include <QHash>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+#include <QDateTime>
+#include <QSqlDatabase>
+
+// Who worked on a file or directory: path prefix -> user -> (last time, count)
+// Updated by SAVE events, every ancestor directory of the file included,
+// so that a prefix query is one lookup
+// Prefixes are matched by whole components, e.g., src/module1 but not src/mod
+// Only the files are persisted, with their own counts, the directories are rebuilt on loading
+// The SAVEs after the latest one in the file are backfilled from the logs on loading
+class PathIndex
+{
+public:
+	struct Entry
+	{
+		Entry() : lastTime(0), count(0) {}
+		uint    lastTime;   // time_t
+		quint32 count;
+	};
+	typedef QHash<QString, Entry> Users;   // user -> entry
+	typedef QPair<QString, QString> Key;   // project, path
+
+public:
+	PathIndex() : latest(0), dirty(false) {}
+	void add(const QString& project, const QString& user, const QString& path, const QDateTime& time);
+	void rename(const QString& oldName, const QString& newName);   // merged if newName has entries
+	Users find(const QString& project, const QString& prefix) const;
+	QDateTime getLatest() const;          // of the SAVEs, null if none
+
+	bool load(const QString& fileName);   // empty if failed
+	bool save(const QString& fileName);   // if modified, replaces the file only when written fully
+
+	// from the SAVE events in Logs, after a time if given
+	void backfill(const QDateTime& after = QDateTime());
+	void backfill(QSqlDatabase database, const QString& project,   // from a shard of the project
+				  const QDateTime& after = QDateTime());
+
+	static QString normalize(const QString& path);
+
+private:
+	void add(const QString& project, const QString& user, const QString& path,
+			 uint time, quint32 count);
+	static void rename(QHash<Key, Users>& index, const QString& oldName, const QString& newName);
+	void clear();
+
+private:
+	QHash<Key, Users> prefixes;   // project, path prefix -> users
+	QHash<Key, Users> files;      // project, file -> users, of the file alone, i.e., the persisted entries
+	uint              latest;     // time_t of the latest SAVE
+	bool              dirty;
+
+	static const quint32 Magic = 0x50494433;   // "PID3", files of the older formats are rebuilt
+};
+
+#endif // PathIndex_h__
@@ -0,0 +1,54 @@
+#include "PersistencePolicy.h"
+#include "TeamRadarEvent.h"
+#include <QStringList>
+
+PersistencePolicy::PersistencePolicy() : numSkipped(0)
+{
+	setPolicy("Request all users",        RelayOnly);
+	setPolicy("Request online status of", RelayOnly);
+	setPolicy("Request photo of",         RelayOnly);
+	setPolicy("Request color of",         RelayOnly);
+	setPolicy("Request location of",      RelayOnly);
+	setPolicy("Request batch of",         RelayOnly);
+}
+
+void PersistencePolicy::parse(const QString& setting)
+{
+	foreach(const QString& item, setting.split(";", QString::SkipEmptyParts))
+	{
+		QStringList pair = item.split("=");
+		if(pair.size() != 2)
+			continue;
+
+		QString     type   = pair[0].trimmed();
+		QStringList policy = pair[1].trimmed().split(",");
+		if(policy[0] == "PERSIST")
+			setPolicy(type, Persist);
+		else if(policy[0] == "RELAY_ONLY")
+			setPolicy(type, RelayOnly);
+		else if(policy[0] == "SAMPLED" && policy.size() == 2)
+			setPolicy(type, Sampled, policy[1].toInt());
+	}
+}
+
+void PersistencePolicy::setPolicy(const QString& eventType, Policy policy, int sampling)
+{
+	Rule rule;
+	rule.policy   = policy;
+	rule.sampling = qMax(sampling, 1);
+	rules.insert(eventType, rule);
+}
+
+bool PersistencePolicy::shouldPersist(const TeamRadarEvent& event)
+{
+	QHash<QString, Rule>::ConstIterator it = rules.find(event.eventType);
+	if(it == rules.end() || it->policy == Persist)
+		return true;
+
+	bool result = false;
+	if(it->policy == Sampled)
+		result = counters[qMakePair(event.userName, event.eventType)]++ % it->sampling == 0;
+	if(!result)
+		++numSkipped;
+	return result;
+}
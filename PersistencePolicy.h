@@ -0,0 +1,39 @@
+#ifndef PersistencePolicy_h__
+#define PersistencePolicy_h__
+
+#include <QHash>
+#include <QPair>
+#include <QString>
+
+struct TeamRadarEvent;
+
+// Decides, per event type, whether an event is written to the log
+// Applied before the logger, so relay-only events never touch the db
+// Format of the setting: type1=policy;type2=policy;...
+//   policy: PERSIST, SAMPLED,n (1 out of n per user), RELAY_ONLY
+// The request-audit rows (e.g., Request color of) are relay-only by default
+class PersistencePolicy
+{
+public:
+	typedef enum {Persist, Sampled, RelayOnly} Policy;
+
+public:
+	PersistencePolicy();
+	void parse(const QString& setting);   // overrides the defaults
+	void setPolicy(const QString& eventType, Policy policy, int sampling = 1);
+	bool shouldPersist(const TeamRadarEvent& event);
+	qint64 getNumSkipped() const { return numSkipped; }
+
+private:
+	struct Rule
+	{
+		Policy policy;
+		int    sampling;
+	};
+
+	QHash<QString, Rule>                rules;      // event type -> rule, Persist if absent
+	QHash<QPair<QString, QString>, int> counters;   // (user, event type) -> sampled events
+	qint64                              numSkipped;
+};
+
+#endif // PersistencePolicy_h__
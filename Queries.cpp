@@ -0,0 +1,196 @@
+#include "Queries.h"
+#include "PhaseDivider.h"
+#include "MainWnd.h"
+#include "Connection.h"
+#include "ActivityRollup.h"
+#include <climits>
+#include <QSqlQuery>
+#include <QVariant>
+
+EventsQuery::EventsQuery(Connection* connection,
+						 const QStringList& u, const QStringList& e,
+						 const QDateTime& s, const QDateTime& t,
+						 const QStringList& p, int f)
+	: DBJob(connection), users(u), eventTypes(e), startTime(s), endTime(t), phases(p), fuzziness(f)
+{
+	pageSize = -1;
+	afterID  = -1;
+	maxRows  = maxBytes = INT_MAX;
+	paged    = false;
+	numLoaded = 0;
+}
+
+void EventsQuery::setPage(int size, const QByteArray& token, int rows, int bytes)
+{
+	pageSize = size;
+	maxRows  = qMax(rows,  1);
+	maxBytes = qMax(bytes, 1);
+	if(!decodeToken(token, afterTime, afterID))
+		afterID = -1;
+}
+
+static bool earlier(const TeamRadarEvent& lhs, const TeamRadarEvent& rhs) {
+	return lhs.time < rhs.time || (lhs.time == rhs.time && lhs.id < rhs.id);
+}
+
+void EventsQuery::run(QSqlDatabase& database)
+{
+	int limit = pageSize > 0 ? qMin(pageSize, maxRows) : maxRows;
+	Events events;
+	if(phases.isEmpty())   // the db does the paging
+	{
+		events = queryEvents(database, users, eventTypes, startTime, endTime,
+							 afterTime, afterID, limit + 1);
+		numLoaded = events.size();
+	}
+	else
+	{
+		// phases are computed on the whole history, then paged
+		Events all = queryEvents(database, users, eventTypes, startTime, endTime);
+		numLoaded = all.size();
+		PhaseDivider divider(all, fuzziness);
+		foreach(const TeamRadarEvent& event, divider.getEvents(phases))
+			if(afterID < 0 || isAfter(event, afterTime, afterID))
+				events << event;
+		qStableSort(events.begin(), events.end(), earlier);
+	}
+
+	// encode within the budgets
+	bool more = false;
+	int  bytes = 0;
+	for(int i = 0; i < events.size(); ++i)
+	{
+		QByteArray packet = Sender::makeEventsReply(events.at(i));
+		if(result.size() == limit || (!result.isEmpty() && bytes + packet.size() > maxBytes))
+		{
+			more = true;
+			nextToken = encodeToken(events.at(i - 1));
+			break;
+		}
+		bytes += packet.size();
+		result << packet;
+	}
+	paged = pageSize >= 0 || more;
+}
+
+// Format of token: base64 of time,id
+QByteArray EventsQuery::encodeToken(const TeamRadarEvent& event)
+{
+	return (event.time.toString(MainWnd::dateTimeFormat).toUtf8() + Connection::Delimiter3 +
+			QByteArray::number(event.id)).toBase64();
+}
+
+bool EventsQuery::decodeToken(const QByteArray& token, QDateTime& time, int& id)
+{
+	QList<QByteArray> sections = QByteArray::fromBase64(token).split(Connection::Delimiter3);
+	if(sections.size() != 2)
+		return false;
+	time = QDateTime::fromString(sections[0], MainWnd::dateTimeFormat);
+	bool ok;
+	id = sections[1].toInt(&ok);
+	return time.isValid() && ok;
+}
+
+bool EventsQuery::isAfter(const TeamRadarEvent& event, const QDateTime& time, int id) {
+	return event.time > time || (event.time == time && event.id > id);
+}
+
+Events EventsQuery::queryEvents(QSqlDatabase& database,
+								const QStringList& users, const QStringList& eventTypes,
+								const QDateTime& startTime, const QDateTime& endTime,
+								const QDateTime& afterTime, int afterID, int limit)
+{
+	QString userClause  = users     .isEmpty() ? "1" : QObject::tr("Client in (\"%1\")").arg(users     .join("\", \""));
+	QString eventClause = eventTypes.isEmpty() ? "1" : QObject::tr("Event  in (\"%1\")").arg(eventTypes.join("\", \""));
+	QString timeClause  = startTime.isNull() || endTime.isNull() ? "1"
+						: QObject::tr("Time between \"%1\" and \"%2\"")
+						  .arg(startTime.toString(MainWnd::dateTimeFormat))
+						  .arg(endTime  .toString(MainWnd::dateTimeFormat));
+	QString afterClause = afterID < 0 ? "1"
+						: QObject::tr("(Time > \"%1\" or (Time = \"%1\" and ID > %2))")
+						  .arg(afterTime.toString(MainWnd::dateTimeFormat))
+						  .arg(afterID);
+	QString limitClause = limit < 0 ? QString() : QObject::tr("limit %1").arg(limit);
+	QSqlQuery query(database);
+	query.exec(QObject::tr("select Client, Event, Parameters, Time, ID from Logs \
+						   where %1 and %2 and %3 and %4 order by Time, ID %5")
+			   .arg(userClause)
+			   .arg(eventClause)
+			   .arg(timeClause)
+			   .arg(afterClause)
+			   .arg(limitClause));
+
+	Events result;
+	while(query.next())
+	{
+		result << TeamRadarEvent(query.value(0).toString(),
+								 query.value(1).toString(),
+								 query.value(2).toString(),
+								 query.value(3).toString());
+		result.last().id = query.value(4).toInt();
+	}
+	return result;
+}
+
+//////////////////////////////////////////////////////////////////////////
+LocationQuery::LocationQuery(Connection* connection, const QString& target)
+	: DBJob(connection), targetUser(target)
+{}
+
+void LocationQuery::run(QSqlDatabase& database) {
+	result = queryLocation(database, targetUser);
+}
+
+QString LocationQuery::queryLocation(QSqlDatabase& database, const QString& targetUser)
+{
+	// find the last SAVE event
+	QSqlQuery query(database);
+	query.exec(QObject::tr("select Parameters from Logs where Client = \"%1\" \
+						   and Event = \"SAVE\" order by Time desc").arg(targetUser));
+	return query.next() ? query.value(0).toString() : QString();
+}
+
+//////////////////////////////////////////////////////////////////////////
+ActivityQuery::ActivityQuery(Connection* connection, const QString& p,
+							 const QDateTime& s, const QDateTime& e, const QString& r,
+							 const QStringList& u, const QStringList& t)
+	: DBJob(connection), project(p), startTime(s), endTime(e), resolution(r), users(u), eventTypes(t)
+{}
+
+void ActivityQuery::run(QSqlDatabase& database)
+{
+	QString userClause  = users     .isEmpty() ? "1" : QObject::tr("Client in (\"%1\")").arg(users     .join("\", \""));
+	QString eventClause = eventTypes.isEmpty() ? "1" : QObject::tr("Event  in (\"%1\")").arg(eventTypes.join("\", \""));
+	QString timeClause  = startTime.isNull() || endTime.isNull() ? "1"
+						: QObject::tr("Bucket between \"%1\" and \"%2\"")
+						  .arg(ActivityRollup::getBucket(startTime, resolution))
+						  .arg(ActivityRollup::getBucket(endTime,   resolution));
+	QSqlQuery query(database);
+	query.exec(QObject::tr("select Client, Event, Bucket, Count from Activity \
+						   where Project = \"%1\" and Resolution = \"%2\" and %3 and %4 and %5 \
+						   order by Bucket")
+			   .arg(project)
+			   .arg(resolution)
+			   .arg(userClause)
+			   .arg(eventClause)
+			   .arg(timeClause));
+	while(query.next())
+		result << query.value(0).toString().toUtf8() + Connection::Delimiter2 +
+				  query.value(1).toString().toUtf8() + Connection::Delimiter2 +
+				  query.value(2).toString().toUtf8() + Connection::Delimiter2 +
+				  query.value(3).toByteArray();
+}
+
+//////////////////////////////////////////////////////////////////////////
+TimeSpanQuery::TimeSpanQuery(Connection* connection) : DBJob(connection) {}
+
+void TimeSpanQuery::run(QSqlDatabase& database)
+{
+	QSqlQuery query(database);
+	query.exec("select min(Time), max(Time) from Logs");
+	if(query.next())
+	{
+		start = query.value(0).toString().toUtf8();
+		end   = query.value(1).toString().toUtf8();
+	}
+}
@@ -0,0 +1,113 @@
+#ifndef Queries_h__
+#define Queries_h__
+
+#include "QueryExecutor.h"
+#include "TeamRadarEvent.h"
+#include <QStringList>
+
+// The read-only queries of the request handlers, run by QueryExecutor
+
+// REQ_EVENTS: events filtered by users, types, time span, and phases
+// The result is one page, ordered by (time, id), and encoded as EVENTS_REPLY packets
+// A page ends when its size or the row & byte budgets are reached,
+// the token of its last event is where the next page starts
+class EventsQuery : public DBJob
+{
+public:
+	EventsQuery(Connection* connection,
+				const QStringList& users, const QStringList& eventTypes,
+				const QDateTime& startTime, const QDateTime& endTime,
+				const QStringList& phases, int fuzziness);
+	void setPage(int pageSize, const QByteArray& token, int maxRows, int maxBytes);
+	void run(QSqlDatabase& database);
+
+	const QList<QByteArray>& getResult() const { return result; }
+	bool       isPaged()      const { return paged;     }   // an EVENTS_PAGE_END is needed
+	QByteArray getNextToken() const { return nextToken; }   // empty for the last page
+	int        getNumLoaded() const { return numLoaded; }   // events read from the db
+
+	static Events queryEvents(QSqlDatabase& database,
+							  const QStringList& users      = QStringList(),
+							  const QStringList& eventTypes = QStringList(),
+							  const QDateTime&   startTime  = QDateTime(),
+							  const QDateTime&   endTime    = QDateTime(),
+							  const QDateTime&   afterTime  = QDateTime(),  // exclusive (time, id)
+							  int                afterID    = -1,
+							  int                limit      = -1);
+
+private:
+	static QByteArray encodeToken(const TeamRadarEvent& event);
+	static bool decodeToken(const QByteArray& token, QDateTime& time, int& id);
+	static bool isAfter(const TeamRadarEvent& event, const QDateTime& time, int id);
+
+private:
+	QStringList users;
+	QStringList eventTypes;
+	QDateTime   startTime;
+	QDateTime   endTime;
+	QStringList phases;
+	int         fuzziness;
+
+	int         pageSize;    // -1 for unpaged requests
+	QDateTime   afterTime;   // from the token
+	int         afterID;
+	int         maxRows;
+	int         maxBytes;
+
+	QList<QByteArray> result;
+	int               numLoaded;
+	bool              paged;
+	QByteArray        nextToken;
+};
+
+// REQ_LOCATION: parameters of the last SAVE event of the target user
+class LocationQuery : public DBJob
+{
+public:
+	LocationQuery(Connection* connection, const QString& targetUser);
+	void run(QSqlDatabase& database);
+	QString getTargetUser() const { return targetUser; }
+	QString getResult()     const { return result; }     // null if not found
+
+	static QString queryLocation(QSqlDatabase& database, const QString& targetUser);
+
+private:
+	QString targetUser;
+	QString result;
+};
+
+// REQ_TIMESPAN: time of the first and the last event
+class TimeSpanQuery : public DBJob
+{
+public:
+	TimeSpanQuery(Connection* connection);
+	void run(QSqlDatabase& database);
+	QByteArray getStart() const { return start; }
+	QByteArray getEnd()   const { return end;   }
+
+private:
+	QByteArray start;
+	QByteArray end;
+};
+
+// REQ_ACTIVITY: bucketed counts of events from the Activity rollups
+class ActivityQuery : public DBJob
+{
+public:
+	ActivityQuery(Connection* connection, const QString& project,
+				  const QDateTime& startTime, const QDateTime& endTime, const QString& resolution,
+				  const QStringList& users, const QStringList& eventTypes);
+	void run(QSqlDatabase& database);
+	const QList<QByteArray>& getResult() const { return result; }   // user;type;bucket;count
+
+private:
+	QString     project;
+	QDateTime   startTime;
+	QDateTime   endTime;
+	QString     resolution;
+	QStringList users;
+	QStringList eventTypes;
+	QList<QByteArray> result;
+};
+
+#endif // Queries_h__
@@ -0,0 +1,125 @@
+#include "QueryExecutor.h"
+#include "Connection.h"
+#include <QRunnable>
+#include <QThreadStorage>
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QSqlQuery>
+#include <QThread>
+
+namespace {
+
+QThreadStorage<QString*> connectionNames;   // db connection of each worker thread
+
+qint64 now()
+{
+	static QElapsedTimer timer;
+	if(!timer.isValid())
+		timer.start();
+	return timer.elapsed();
+}
+
+}
+
+DBJob::DBJob(Connection* c) : connection(c), submitTime(0) {}
+
+void DBJob::onFinished()
+{
+	emit finished();
+	deleteLater();
+}
+
+//////////////////////////////////////////////////////////////////////////
+class JobRunner : public QRunnable
+{
+public:
+	JobRunner(QueryExecutor* e, DBJob* j) : executor(e), job(j) {}
+	void run() { executor->run(job); }
+
+private:
+	QueryExecutor* executor;
+	DBJob*         job;
+};
+
+QueryExecutor::QueryExecutor(QObject* parent) : QObject(parent)
+{
+	queueDepth = 0;
+	numStarted = totalWait = maxWait = 0;
+	pool.setMaxThreadCount(2);
+	pool.setExpiryTimeout(-1);   // keep the threads, and their db connections
+}
+
+QueryExecutor::~QueryExecutor()
+{
+	pool.waitForDone();
+	foreach(const QString& name, connections)
+		QSqlDatabase::removeDatabase(name);
+}
+
+void QueryExecutor::setDatabaseName(const QString& name) {
+	databaseName = name;
+}
+
+void QueryExecutor::setMaxThreads(int count) {
+	pool.setMaxThreadCount(qMax(count, 1));
+}
+
+void QueryExecutor::submit(DBJob* job)
+{
+	{
+		QMutexLocker locker(&mutex);
+		++queueDepth;
+	}
+	job->submitTime = now();
+	pool.start(new JobRunner(this, job));
+}
+
+void QueryExecutor::run(DBJob* job)
+{
+	qint64 wait = now() - job->submitTime;
+	{
+		QMutexLocker locker(&mutex);
+		--queueDepth;
+		++numStarted;
+		totalWait += wait;
+		maxWait = qMax(maxWait, wait);
+	}
+
+	QSqlDatabase database = getDatabase();
+	job->run(database);
+	QMetaObject::invokeMethod(job, "onFinished", Qt::QueuedConnection);   // back to the main thread
+}
+
+QSqlDatabase QueryExecutor::getDatabase()
+{
+	if(!connectionNames.hasLocalData())
+	{
+		QString name = QString("Worker%1").arg(quintptr(QThread::currentThreadId()));
+		QSqlDatabase database = QSqlDatabase::addDatabase("QSQLITE", name);
+		database.setDatabaseName(databaseName);
+		if(database.open())
+			QSqlQuery(database).exec("PRAGMA journal_mode=WAL");
+		connectionNames.setLocalData(new QString(name));
+		QMutexLocker locker(&mutex);
+		connections << name;
+	}
+	return QSqlDatabase::database(*connectionNames.localData());
+}
+
+int QueryExecutor::getQueueDepth() const
+{
+	QMutexLocker locker(&mutex);
+	return queueDepth;
+}
+
+qint64 QueryExecutor::getAverageWait() const
+{
+	QMutexLocker locker(&mutex);
+	return numStarted > 0 ? totalWait / numStarted : 0;
+}
+
+qint64 QueryExecutor::getMaxWait() const
+{
+	QMutexLocker locker(&mutex);
+	return maxWait;
+}
@@ -0,0 +1,75 @@
+#ifndef QueryExecutor_h__
+#define QueryExecutor_h__
+
+#include <QObject>
+#include <QPointer>
+#include <QThreadPool>
+#include <QSqlDatabase>
+#include <QMutex>
+#include <QStringList>
+
+class Connection;
+
+// A unit of db work
+// run() is called on a worker thread, with the connection of that thread
+// finished() is emitted on the main thread afterwards, and the job deletes itself
+class DBJob : public QObject
+{
+	Q_OBJECT
+
+public:
+	DBJob(Connection* c);
+	Connection* getConnection() const { return connection; }   // 0 if disconnected meanwhile
+	virtual void run(QSqlDatabase& database) = 0;
+
+signals:
+	void finished();
+
+private slots:
+	void onFinished();
+
+private:
+	QPointer<Connection> connection;   // the client that asked for it
+
+	friend class QueryExecutor;
+	qint64 submitTime;                 // for the wait time
+};
+
+// Runs DBJobs on a small pool of threads, each holding its own QSqlDatabase connection
+// The db is in WAL mode, so that the readers do not block the logger on the main thread
+class QueryExecutor : public QObject
+{
+	Q_OBJECT
+
+public:
+	QueryExecutor(QObject* parent = 0);
+	~QueryExecutor();
+
+	void setDatabaseName(const QString& name);
+	void setMaxThreads(int count);
+	void submit(DBJob* job);   // takes the ownership
+
+	// statistics
+	int    getQueueDepth()  const;   // submitted, but not started yet
+	qint64 getAverageWait() const;   // msecs
+	qint64 getMaxWait()     const;
+
+private:
+	void run(DBJob* job);            // on the worker thread
+	QSqlDatabase getDatabase();      // of the current thread
+
+	friend class JobRunner;
+
+private:
+	QThreadPool pool;
+	QString     databaseName;
+	QStringList connections;         // of the worker threads, guarded by mutex
+
+	mutable QMutex mutex;            // guards the statistics
+	int    queueDepth;
+	qint64 numStarted;
+	qint64 totalWait;
+	qint64 maxWait;
+};
+
+#endif // QueryExecutor_h__
@@ -0,0 +1,75 @@
+#include "RateLimiter.h"
+#include <QDateTime>
+#include <QStringList>
+
+// no limits unless the setting asks for them, the legacy clients do not understand BUSY
+double RateLimiter::rates [NumClasses] = {0, 0, 0, 0, 0};
+int    RateLimiter::bursts[NumClasses] = {1, 1, 1, 1, 1};
+qint64 RateLimiter::numRejected = 0;
+
+RateLimiter::RateLimiter()
+{
+	for(int i = 0; i < NumClasses; ++i)
+	{
+		buckets[i].tokens     = bursts[i];
+		buckets[i].lastRefill = -1;
+		buckets[i].rejected   = 0;
+	}
+}
+
+bool RateLimiter::acquire(MessageClass messageClass) {
+	return acquire(messageClass, QDateTime::currentMSecsSinceEpoch());
+}
+
+bool RateLimiter::acquire(MessageClass messageClass, qint64 now)
+{
+	double rate = rates[messageClass];
+	if(rate <= 0)
+		return true;
+
+	Bucket& bucket = buckets[messageClass];
+	if(bucket.lastRefill >= 0)
+		bucket.tokens = qMin(double(bursts[messageClass]),
+							 bucket.tokens + (now - bucket.lastRefill) * rate / 1000);
+	bucket.lastRefill = now;
+	if(bucket.tokens >= bursts[messageClass])   // the client has slowed down
+		bucket.rejected = 0;
+
+	if(bucket.tokens < 1)
+	{
+		++bucket.rejected;
+		++numRejected;
+		return false;
+	}
+	bucket.tokens -= 1;
+	return true;
+}
+
+bool RateLimiter::isNewlyThrottled(MessageClass messageClass) const {
+	return buckets[messageClass].rejected == 1;
+}
+
+void RateLimiter::parse(const QString& setting)
+{
+	QStringList names = QStringList() << "EVENTS" << "CHAT" << "HISTORY" << "PHOTOS";
+	foreach(const QString& item, setting.split(";", QString::SkipEmptyParts))
+	{
+		QStringList pair = item.split("=");
+		if(pair.size() != 2)
+			continue;
+
+		int messageClass   = names.indexOf(pair[0].trimmed().toUpper());
+		QStringList limit  = pair[1].trimmed().split("/");
+		if(messageClass < 0)
+			continue;
+		double rate = limit[0].toDouble();
+		int burst   = limit.size() == 2 ? limit[1].toInt() : int(rate);
+		setLimit(MessageClass(messageClass), rate, burst);
+	}
+}
+
+void RateLimiter::setLimit(MessageClass messageClass, double rate, int burst)
+{
+	rates [messageClass] = qMax(rate, 0.0);
+	bursts[messageClass] = qMax(burst, 1);
+}
@@ -0,0 +1,52 @@
+#ifndef RateLimiter_h__
+#define RateLimiter_h__
+
+#include <QString>
+
+// Token buckets of a connection, one for each class of messages
+// A bucket holds up to burst tokens, and is refilled at rate tokens per second
+// A message takes one token, and is rejected if there is none
+// The limits are shared by all the connections
+// Format of the setting: class1=rate/burst;class2=rate/burst;...
+//   class: EVENTS, CHAT, HISTORY, PHOTOS; rate 0 for no limit
+//   e.g., EVENTS=50/200;CHAT=5/20;HISTORY=2/10;PHOTOS=5/50; no limit if empty
+class RateLimiter
+{
+public:
+	typedef enum {
+		Events,      // EVENT
+		Chat,        // CHAT
+		History,     // REQ_EVENTS, REQ_TIMESPAN, REQ_ACTIVITY, REQ_FILE_ACTIVITY
+		Photos,      // REG_PHOTO, REQ_PHOTO, and each REQ_PHOTO in a REQ_BATCH
+		Unlimited,   // the rest, e.g., GREETING, REQ_SNAPSHOT (cached), REQ_BATCH
+		NumClasses
+	} MessageClass;
+
+public:
+	RateLimiter();
+	bool acquire(MessageClass messageClass);
+	bool acquire(MessageClass messageClass, qint64 now);   // now in msecs
+
+	// true for the first rejection since the bucket was full, for telling the client once
+	bool isNewlyThrottled(MessageClass messageClass) const;
+
+	static void parse(const QString& setting);   // overrides the defaults
+	static void setLimit(MessageClass messageClass, double rate, int burst);
+	static qint64 getNumRejected() { return numRejected; }
+
+private:
+	struct Bucket
+	{
+		double tokens;
+		qint64 lastRefill;   // msecs, -1 for never
+		int    rejected;     // since the bucket was full
+	};
+
+	Bucket buckets[NumClasses];
+
+	static double rates [NumClasses];   // tokens per second
+	static int    bursts[NumClasses];
+	static qint64 numRejected;          // by all connections
+};
+
+#endif // RateLimiter_h__
@@ -0,0 +1,74 @@
+#include "Scheduler.h"
+#include "Connection.h"
+#include <QTimer>
+#include <QElapsedTimer>
+
+Scheduler::Scheduler(QObject* parent) : QObject(parent)
+{
+	sliceSize  = 16;
+	bulkBudget = 5;
+	posted     = false;
+}
+
+void Scheduler::setSliceSize(int packets) {
+	sliceSize = qMax(packets, 0);
+}
+
+void Scheduler::setBulkBudget(int msecs) {
+	bulkBudget = qMax(msecs, 0);
+}
+
+void Scheduler::schedule(Connection* connection)
+{
+	if(sliceSize == 0)
+	{
+		while(connection->processPackets(Connection::MaxQueuedPackets, true) > 0) {}
+		return;
+	}
+	if(!connection->hasPackets() || ready.contains(QPointer<Connection>(connection)))
+		return;
+	ready << connection;
+	post();
+}
+
+// after the pending events, e.g., readyRead of the other sockets
+void Scheduler::post()
+{
+	if(posted)
+		return;
+	posted = true;
+	QTimer::singleShot(0, this, SLOT(onRound()));
+}
+
+void Scheduler::onRound()
+{
+	posted = false;
+
+	// live first
+	for(int i = 0; i < ready.size(); ++i)
+		if(Connection* connection = ready[i])
+			connection->processPackets(sliceSize, false);
+
+	// bulk, in turns; one slice at least, so that it never starves
+	QElapsedTimer elapsed;
+	elapsed.start();
+	int turns = 0;
+	for(int i = 0; i < ready.size() && (turns == 0 || elapsed.elapsed() < bulkBudget); ++i)
+	{
+		Connection* connection = ready[i];
+		if(connection == 0 || !connection->isNextBulk())
+			continue;
+		connection->processPackets(sliceSize, true);
+		ready.move(i--, ready.size() - 1);   // to the end of the line
+		++turns;
+		if(turns == ready.size())
+			break;
+	}
+
+	// the drained and the closed leave
+	for(int i = ready.size() - 1; i >= 0; --i)
+		if(ready[i].isNull() || !ready[i]->hasPackets())
+			ready.removeAt(i);
+	if(!ready.isEmpty())
+		post();
+}
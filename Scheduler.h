@@ -0,0 +1,41 @@
+#ifndef Scheduler_h__
+#define Scheduler_h__
+
+#include <QObject>
+#include <QList>
+#include <QPointer>
+
+class Connection;
+
+// Processes the inbound packets of the connections in bounded slices, one round per event loop turn,
+// so that a client pipelining thousands of requests does not hold up the others
+// Each round:
+//   live: every ready connection processes up to a slice, stopping at a bulk request (history, photos)
+//   bulk: connections with a bulk request at their head take turns, until the bulk budget is spent
+// The sockets are read between the rounds, so new live events are relayed in the next round
+class Scheduler : public QObject
+{
+	Q_OBJECT
+
+public:
+	Scheduler(QObject* parent = 0);
+	void setSliceSize(int packets);   // 0 for no slicing: a connection is drained when it has data
+	void setBulkBudget(int msecs);    // of each round
+	void schedule(Connection* connection);   // it has packets
+
+	int getNumReady() const { return ready.size(); }
+
+private slots:
+	void onRound();
+
+private:
+	void post();
+
+private:
+	QList<QPointer<Connection> > ready;   // round-robin order
+	int  sliceSize;
+	int  bulkBudget;
+	bool posted;                          // a round is pending
+};
+
+#endif // Scheduler_h__
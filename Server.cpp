@@ -1,12 +1,109 @@
 #include "Server.h"
 #include "Connection.h"
+#include "PacketRecorder.h"
+#include "BufferPool.h"
+#include <QTcpSocket>
+#include <QLocalSocket>
 
-Server::Server(QObject* parent) : QTcpServer(parent)
-{}
+Server::Server(QObject* parent) : QTcpServer(parent), handler(0)
+{
+	budget         = 0;
+	numConnections = 0;
+	numRefused     = 0;
+	numShed        = 0;
+	connect(&localServer, SIGNAL(newConnection()), this, SLOT(onLocalConnection()));
+	connect(&memoryTimer, SIGNAL(timeout()), this, SLOT(onCheckMemory()));
+	memoryTimer.start(1000);
+}
+
+// a name in use by a running server is not taken over, one left by a crash is
+bool Server::listenLocal(const QString& name)
+{
+	localServer.close();
+	if(name.isEmpty())
+		return false;
+	if(localServer.listen(name))
+		return true;
+	if(localServer.serverError() != QAbstractSocket::AddressInUseError)
+		return false;
+
+	QLocalSocket probe;
+	probe.connectToServer(name);
+	if(probe.waitForConnected(1000))
+	{
+		qDebug() << "Local socket" << name << "is in use by another server";
+		return false;
+	}
+	QLocalServer::removeServer(name);
+	return localServer.listen(name);
+}
 
 void Server::incomingConnection(int socketDescriptor)
 {
-	Connection *connection = new Connection(this);
-	connection->setSocketDescriptor(socketDescriptor);
+	QTcpSocket* socket = new QTcpSocket;
+	socket->setSocketDescriptor(socketDescriptor);
+	addConnection(socket);
+}
+
+void Server::onLocalConnection()
+{
+	while(QLocalSocket* socket = localServer.nextPendingConnection())
+		addConnection(socket);
+}
+
+// same framing and handling for both kinds of sockets
+void Server::addConnection(QIODevice* socket)
+{
+	if(budget > 0 && usage.getTotal() >= budget)
+		return refuse(socket);
+
+	Connection *connection = new Connection(socket, handler, this);
+	usage.objects += sizeof(Connection) + Connection::SocketOverhead;   // until the next check
+	++numConnections;
+	connection->setScheduler(&scheduler);
+	connection->setTimerWheel(&wheel);
+	PacketRecorder::recordOpen(connection->getID());
 	emit newConnection(connection);
-}
\ No newline at end of file
+}
+
+// told why, and closed after the reply is sent
+void Server::refuse(QIODevice* socket)
+{
+	++numRefused;
+	socket->write(Sender::makeBusyReply("GREETING", "MEMORY"));
+	connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+	if(QTcpSocket* tcpSocket = qobject_cast<QTcpSocket*>(socket))
+		tcpSocket->disconnectFromHost();
+	else if(QLocalSocket* localSocket = qobject_cast<QLocalSocket*>(socket))
+		localSocket->disconnectFromServer();
+}
+
+// over the budget, the pooled buffers go first, then the connections holding the most
+// typically the slow consumers, with a long output queue
+void Server::onCheckMemory()
+{
+	QList<QPair<qint64, Connection*> > sizes;
+	usage = MemoryUsage();
+	foreach(Connection* connection, findChildren<Connection*>())
+	{
+		MemoryUsage connectionUsage = connection->getMemoryUsage();
+		usage += connectionUsage;
+		sizes << qMakePair(connectionUsage.getTotal(), connection);
+	}
+	numConnections = sizes.size();
+	if(budget <= 0 || usage.getTotal() + BufferPool::getPooledBytes() <= budget)
+		return;
+
+	BufferPool::trim();
+	qSort(sizes);   // the biggest last
+	qint64 total = usage.getTotal();
+	while(total > budget && !sizes.isEmpty())
+	{
+		QPair<qint64, Connection*> biggest = sizes.takeLast();
+		qDebug() << "Over the memory budget, dropping" << biggest.second->getUserName()
+				 << "holding" << biggest.first << "bytes";
+		biggest.second->drop();
+		total -= biggest.first;
+		++numShed;
+	}
+}
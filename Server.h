@@ -2,10 +2,17 @@
 #define SERVER_H
 
 // Listen, and create new Connections
+// TCP for remote clients, and a local socket (Unix domain socket/named pipe) for co-located ones
 
 #include <QTcpServer>
+#include <QLocalServer>
+#include "Scheduler.h"
+#include "TimerWheel.h"
+#include "MemoryUsage.h"
+#include <QTimer>
 
 class Connection;
+class CommandHandler;
 
 class Server : public QTcpServer
 {
@@ -13,12 +20,45 @@ class Server : public QTcpServer
 
 public:
 	Server(QObject* parent = 0);
+	void setHandler(CommandHandler* h) { handler = h; }   // of the new connections
+	bool listenLocal(const QString& name);   // empty name for no local socket
+	QString getLocalName() const { return localServer.fullServerName(); }
+	Scheduler* getScheduler() { return &scheduler; }   // of the inbound work of all connections
+	int getNumTimers() const { return wheel.getNumActive(); }
+
+	// the memory of the connections, checked every second
+	// over the budget, new connections are refused, and the biggest ones are dropped
+	void setMemoryBudget(qint64 bytes) { budget = bytes; }   // 0 for no limit
+	MemoryUsage getMemoryUsage() const { return usage; }     // as of the last check
+	int    getNumConnections() const { return numConnections; }
+	qint64 getNumRefused() const { return numRefused; }
+	qint64 getNumShed()    const { return numShed;    }
 
 signals:
 	void newConnection(Connection *connection);
 
 protected:
 	void incomingConnection(int socketDescriptor);
+
+private slots:
+	void onLocalConnection();
+	void onCheckMemory();
+
+private:
+	void addConnection(QIODevice* socket);
+	void refuse(QIODevice* socket);
+
+private:
+	QLocalServer    localServer;
+	CommandHandler* handler;
+	Scheduler       scheduler;
+	TimerWheel      wheel;             // deadlines of all connections
+	QTimer          memoryTimer;
+	qint64          budget;            // bytes
+	MemoryUsage     usage;
+	int             numConnections;
+	qint64          numRefused;
+	qint64          numShed;
 };
 
 #endif // SERVER_H
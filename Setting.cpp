@@ -18,11 +18,11 @@ void Setting::loadDefaults()
 }
 
 QString Setting::getIPAddress() const {
-	return value("IPAddress").toString();
+	return get("IPAddress").toString();
 }
 
 quint16 Setting::getPort() const {
-	return value("Port").toInt();
+	return get("Port").toInt();
 }
 
 void Setting::setIPAddress(const QString& address) {
@@ -33,8 +33,147 @@ void Setting::setPort(quint16 port) {
 	setValue("Port", port);
 }
 
+// by default unique on the host, as the port is; the default port keeps the old name
+QString Setting::getLocalSocketName() const
+{
+	QVariant name = get("LocalSocketName");
+	if(!name.isNull())
+		return name.toString();
+	quint16 port = getPort();
+	return port == 12345 ? "TeamRadarServer" : QString("TeamRadarServer-%1").arg(port);
+}
+
 QString Setting::getPhotoDir() const {
-	return value("PhotoPath").toString();
+	return get("PhotoPath").toString();
+}
+
+QString Setting::getCaptureDir() const {
+	return get("CaptureDir").toString();
+}
+
+int Setting::getResumeRingSize() const {
+	int size = get("ResumeRingSize").toInt();
+	return size > 0 ? size : 1000;
+}
+
+int Setting::getCoalesceWindow() const
+{
+	QVariant window = get("CoalesceWindow");
+	return window.isNull() ? 250 : window.toInt();
+}
+
+QStringList Setting::getCoalesceTypes() const
+{
+	QVariant types = get("CoalesceTypes");
+	return types.isNull() ? QStringList() << "SAVE" << "MODE"
+						  : types.toString().split(";", QString::SkipEmptyParts);
+}
+
+QString Setting::getPersistencePolicy() const {
+	return get("PersistencePolicy").toString();
+}
+
+int Setting::getDBThreads() const
+{
+	int count = get("DBThreads").toInt();
+	return count > 0 ? count : 2;
+}
+
+int Setting::getMaxEventsPerRequest() const
+{
+	int count = get("MaxEventsPerRequest").toInt();
+	return count > 0 ? count : 10000;
+}
+
+int Setting::getMaxBytesPerRequest() const
+{
+	int bytes = get("MaxBytesPerRequest").toInt();
+	return bytes > 0 ? bytes : 4 * 1024 * 1024;
+}
+
+QString Setting::getShardDir() const {
+	return get("ShardDir").toString();
+}
+
+int Setting::getShardIdleTimeout() const
+{
+	int secs = get("ShardIdleTimeout").toInt();
+	return secs > 0 ? secs : 300;
+}
+
+QString Setting::getRateLimits() const {
+	return get("RateLimits").toString();
+}
+
+int Setting::getOverloadThreshold() const
+{
+	QVariant threshold = get("OverloadThreshold");
+	return threshold.isNull() ? 200 : threshold.toInt();
+}
+
+int Setting::getSliceSize() const
+{
+	QVariant packets = get("SliceSize");
+	return packets.isNull() ? 16 : packets.toInt();
+}
+
+int Setting::getKeepAliveInterval() const
+{
+	QVariant secs = get("KeepAliveInterval");
+	return secs.isNull() ? 60 : secs.toInt();
+}
+
+int Setting::getKeepAliveTimeout() const
+{
+	int secs = get("KeepAliveTimeout").toInt();
+	return secs > 0 ? secs : 30;
+}
+
+int Setting::getMemoryBudget() const {
+	return get("MemoryBudget").toInt();
+}
+
+int Setting::getCompressionLevel() const
+{
+	QVariant level = get("CompressionLevel");
+	return level.isNull() ? 1 : qBound(0, level.toInt(), 9);
+}
+
+int Setting::getChunkSize() const
+{
+	QVariant kb = get("ChunkSize");
+	return kb.isNull() ? 16 : qMax(kb.toInt(), 0);
+}
+
+QString Setting::getNodeName() const {
+	return get("NodeName").toString();
+}
+
+quint16 Setting::getClusterPort() const {
+	return get("ClusterPort").toInt();
+}
+
+// comma separated, in the file or on the command line
+QStringList Setting::getClusterPeers() const
+{
+	QStringList result;
+	foreach(const QString& peers, get("ClusterPeers").toStringList())
+		result << peers.split(',', QString::SkipEmptyParts);
+	return result;
+}
+
+void Setting::setArguments(const QStringList& arguments)
+{
+	foreach(const QString& argument, arguments)
+	{
+		int equal = argument.indexOf('=');
+		if(argument.startsWith("--") && equal > 2)
+			overrides.insert(argument.mid(2, equal - 2), argument.mid(equal + 1));
+	}
+}
+
+QVariant Setting::get(const QString& key) const {
+	return overrides.contains(key) ? overrides[key] : value(key);
 }
 
 QString Setting::getCompileDate() const
@@ -2,6 +2,9 @@
 #define Setting_h__
 
 #include "../MySetting/MySetting.h"
+#include <QStringList>
+#include <QMap>
+#include <QVariant>
 
 class Setting : public MySetting<Setting>
 {
@@ -10,14 +13,44 @@ public:
 
 	QString getIPAddress() const;
 	quint16 getPort() const;
+	QString getLocalSocketName() const;   // for co-located clients, empty for none
 	QString getPhotoDir() const;
+	QString getCaptureDir() const;   // empty: no capture
+	int     getResumeRingSize() const;   // EVENTs kept per project for resuming
+	int     getCoalesceWindow() const;   // msecs, 0 for no coalescing
+	QStringList getCoalesceTypes() const;
+	QString getPersistencePolicy() const;   // see PersistencePolicy
+	int     getDBThreads() const;        // worker threads for the queries
+	int     getMaxEventsPerRequest() const;   // budgets of REQ_EVENTS
+	int     getMaxBytesPerRequest()  const;
+	QString getShardDir() const;         // empty: all projects in one db
+	int     getShardIdleTimeout() const; // secs
+	QString getRateLimits() const;       // per connection, see RateLimiter
+	int     getOverloadThreshold() const;   // msecs of event loop lag, 0 for no shedding
+	int     getSliceSize() const;        // packets of a connection per round, 0 for no slicing
+	int     getKeepAliveInterval() const;   // secs of silence before PING, 0 for none
+	int     getKeepAliveTimeout()  const;   // secs to answer PING
+	int     getMemoryBudget() const;     // MB for the connections, 0 for no limit
+	int     getCompressionLevel() const; // 1-9 for zlib, 0 for not offering compression
+	int     getChunkSize() const;        // KB of a chunk of large packets, 0 for not offering chunking
+	QString getNodeName() const;         // unique in the cluster, host:cluster port if empty
+	quint16 getClusterPort() const;      // for the links from the other nodes, 0 for no cluster
+	QStringList getClusterPeers() const; // host:port of the other nodes
 	QString getCompileDate() const;
 
 	void setIPAddress(const QString& address);
 	void setPort(quint16 port);
 
+	// --Key=value, overriding the file for this run only, e.g., for several nodes on one machine
+	// every getter above honors them
+	void setArguments(const QStringList& arguments);
+
 private:
 	void loadDefaults();
+	QVariant get(const QString& key) const;   // overridden, or from the file
+
+private:
+	QMap<QString, QVariant> overrides;
 };
 
 #endif // Setting_h__
@@ -0,0 +1,128 @@
+#include "SnapshotCache.h"
+#include "Connection.h"
+#include "LogShards.h"
+#include <QSqlQuery>
+#include <QStringList>
+#include <QCryptographicHash>
+#include <QFile>
+
+void SnapshotCache::setLogShards(LogShards* logShards) {
+	shards = logShards;
+}
+
+QByteArray SnapshotCache::getSnapshot(const QString& projectName)
+{
+	if(!projects.contains(projectName))
+		load(projectName);
+
+	Project& project = projects[projectName];
+	if(project.packet.isEmpty())   // encode
+	{
+		QList<QByteArray> members;
+		for(QMap<QString, Member>::ConstIterator it = project.members.begin();
+			it != project.members.end(); ++it)
+		{
+			const Member& member = it.value();
+			members << it.key().toUtf8() + Connection::Delimiter2 +
+					   member.color.toUtf8() + Connection::Delimiter2 +
+					   (member.online ? "TRUE" : "FALSE") + Connection::Delimiter2 +
+					   member.photoHash + Connection::Delimiter2 +
+					   member.location.toUtf8();
+		}
+		project.packet = Sender::makeTeamSnapshot(members);
+	}
+	return project.packet;
+}
+
+// two queries for the whole project
+void SnapshotCache::load(const QString& projectName)
+{
+	Project& project = projects[projectName];
+	QSqlQuery query;
+	query.exec(QObject::tr("select Username, Color, Online, Image from Users \
+						   where Username <> \"\" and Project = \"%1\"").arg(projectName));
+	while(query.next())
+	{
+		QString name = query.value(0).toString();
+		Member& member = project.members[name];
+		member.color  = query.value(1).toString();
+		member.online = query.value(2).toBool();
+		QFile file(query.value(3).toString());
+		if(file.open(QFile::ReadOnly))
+			member.photoHash = hash(file.readAll());
+		projectOf.insert(name, projectName);
+	}
+
+	// the last SAVE of each member
+	QStringList names = project.members.keys();
+	if(names.isEmpty())
+		return;
+	QSqlQuery logQuery(shards != 0 ? shards->getDatabase(projectName) : QSqlDatabase::database());
+	logQuery.exec(QObject::tr("select Client, Parameters, max(Time) from Logs \
+							  where Event = \"SAVE\" and Client in (\"%1\") group by Client")
+				  .arg(names.join("\", \"")));
+	while(logQuery.next())
+		project.members[logQuery.value(0).toString()].location = logQuery.value(1).toString();
+}
+
+SnapshotCache::Member* SnapshotCache::getMember(const QString& user)
+{
+	QHash<QString, QString>::ConstIterator it = projectOf.find(user);
+	if(it == projectOf.end())
+		return 0;
+	Project& project = projects[it.value()];
+	project.packet.clear();   // dirty
+	return &project.members[user];
+}
+
+void SnapshotCache::setOnline(const QString& user, bool online) {
+	if(Member* member = getMember(user))
+		member->online = online;
+}
+
+void SnapshotCache::setColor(const QString& user, const QString& color) {
+	if(Member* member = getMember(user))
+		member->color = color;
+}
+
+void SnapshotCache::setPhoto(const QString& user, const QByteArray& photoData) {
+	if(Member* member = getMember(user))
+		member->photoHash = hash(photoData);
+}
+
+void SnapshotCache::setLocation(const QString& user, const QString& location) {
+	if(Member* member = getMember(user))
+		member->location = location;
+}
+
+// the new project is reloaded on the next request
+void SnapshotCache::setProject(const QString& user, const QString& project)
+{
+	QHash<QString, QString>::Iterator it = projectOf.find(user);
+	if(it != projectOf.end() && it.value() == project)
+		return;
+	if(it != projectOf.end())   // leave the old one
+	{
+		Project& oldProject = projects[it.value()];
+		oldProject.members.remove(user);
+		oldProject.packet.clear();
+		projectOf.erase(it);
+	}
+
+	if(projects.contains(project))
+	{
+		foreach(const QString& member, projects[project].members.keys())
+			projectOf.remove(member);
+		projects.remove(project);
+	}
+}
+
+void SnapshotCache::clear()
+{
+	projects .clear();
+	projectOf.clear();
+}
+
+QByteArray SnapshotCache::hash(const QByteArray& data) {
+	return QCryptographicHash::hash(data, QCryptographicHash::Md5).toHex();
+}
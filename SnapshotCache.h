@@ -0,0 +1,57 @@
+#ifndef SnapshotCache_h__
+#define SnapshotCache_h__
+
+#include <QMap>
+#include <QHash>
+#include <QString>
+#include <QByteArray>
+
+class LogShards;
+
+// Keeps the state of the team members of each project, and the encoded TEAM_SNAPSHOT
+// A project is loaded from the db on the first request, and kept up to date by the setters
+// A setter only drops the encoded packet of the affected project
+// Format of TEAM_SNAPSHOT: member1#member2#...
+//   member: name;color;online;photo hash;location
+//   online: TRUE/FALSE; photo hash: md5 in hex, empty for no photo; location may contain ';'
+class SnapshotCache
+{
+	struct Member
+	{
+		Member() : online(false) {}
+		QString    color;
+		bool       online;
+		QByteArray photoHash;
+		QString    location;
+	};
+
+	struct Project
+	{
+		QMap<QString, Member> members;   // name -> member
+		QByteArray            packet;    // empty when dirty
+	};
+
+public:
+	SnapshotCache() : shards(0) {}
+	void setLogShards(LogShards* logShards);   // where the locations are
+	QByteArray getSnapshot(const QString& project);   // encoded packet
+
+	void setOnline  (const QString& user, bool online);
+	void setColor   (const QString& user, const QString& color);
+	void setPhoto   (const QString& user, const QByteArray& photoData);
+	void setLocation(const QString& user, const QString& location);
+	void setProject (const QString& user, const QString& project);
+	void clear();   // drop everything, e.g., after renaming or deleting users
+
+private:
+	Member* getMember(const QString& user);   // 0 if the project is not loaded
+	void load(const QString& project);
+	static QByteArray hash(const QByteArray& data);
+
+private:
+	QHash<QString, Project> projects;    // loaded projects
+	QHash<QString, QString> projectOf;   // user -> loaded project
+	LogShards*              shards;
+};
+
+#endif // SnapshotCache_h__
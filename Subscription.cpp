@@ -0,0 +1,98 @@
+#include "Subscription.h"
+#include "Connection.h"
+#include <QElapsedTimer>
+
+namespace {
+
+// the event types of the plugins and the server, in the order of their bits
+const char* knownTypes[] = {
+	"SAVE",
+	"MODE",
+	"SCM_COMMIT",
+	"JOINED",
+	"DISCONNECTED",
+	"CONNECTED"
+};
+
+qint64 now()
+{
+	static QElapsedTimer timer;
+	if(!timer.isValid())
+		timer.start();
+	return timer.elapsed();
+}
+
+}
+
+Subscription::Subscription() : typeMask(~quint64(0)) {}
+
+Subscription Subscription::parse(const QByteArray& body)
+{
+	Subscription result;
+	QList<QByteArray> sections = body.split(Connection::Delimiter1);
+	if(sections.size() != 3)
+		return result;
+
+	// types
+	if(!sections[0].isEmpty())
+	{
+		result.typeMask = 0;
+		foreach(const QByteArray& type, sections[0].split(Connection::Delimiter2))
+		{
+			int bit = getTypeBit(type);
+			result.typeMask |= quint64(1) << bit;
+			if(bit == OtherBit)
+				result.otherTypes << QString::fromUtf8(type);
+		}
+	}
+
+	// teammates
+	if(!sections[1].isEmpty())
+		foreach(const QByteArray& teammate, sections[1].split(Connection::Delimiter2))
+			result.teammates << QString::fromUtf8(teammate);
+
+	// type,msecs
+	if(!sections[2].isEmpty())
+		foreach(const QByteArray& interval, sections[2].split(Connection::Delimiter2))
+		{
+			QList<QByteArray> pair = interval.split(Connection::Delimiter3);
+			if(pair.size() == 2 && pair[1].toInt() > 0)
+				result.intervals.insert(QString::fromUtf8(pair[0]), pair[1].toInt());
+		}
+
+	return result;
+}
+
+bool Subscription::accepts(int typeBit, const QString& eventType, const QString& source)
+{
+	if(!(typeMask & (quint64(1) << typeBit)))
+		return false;
+	if(typeBit == OtherBit && !otherTypes.isEmpty() && !otherTypes.contains(eventType))
+		return false;
+	if(!teammates.isEmpty() && !teammates.contains(source))
+		return false;
+	if(intervals.isEmpty())
+		return true;
+
+	QHash<QString, qint64>::ConstIterator interval = intervals.find(eventType);
+	if(interval == intervals.end())
+		return true;
+
+	// throttled
+	qint64 current = now();
+	QPair<QString, QString> key(eventType, source);
+	QHash<QPair<QString, QString>, qint64>::Iterator last = lastSent.find(key);
+	if(last != lastSent.end() && current - last.value() < interval.value())
+		return false;
+	lastSent.insert(key, current);
+	return true;
+}
+
+// nothing is registered, so clients cannot grow the table
+int Subscription::getTypeBit(const QString& eventType)
+{
+	for(int i = 0; i < int(sizeof(knownTypes) / sizeof(knownTypes[0])); ++i)
+		if(eventType == QLatin1String(knownTypes[i]))
+			return i;
+	return OtherBit;
+}
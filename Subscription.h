@@ -0,0 +1,39 @@
+#ifndef Subscription_h__
+#define Subscription_h__
+
+#include <QSet>
+#include <QHash>
+#include <QPair>
+#include <QString>
+#include <QByteArray>
+
+// What a client wants to receive in broadcast EVENTs
+// Format of SUBSCRIBE: event types#teammates#intervals
+//   event types: type1;type2;...            empty for all
+//   teammates:   name1;name2;...            empty for all
+//   intervals:   type1,msecs;type2,msecs... minimum interval between two events of the type
+//                                           from the same teammate
+// The known event types are compiled into a bitmask, so that fanout costs one AND per recipient
+// the other types share OtherBit, and are matched by name
+class Subscription
+{
+public:
+	Subscription();   // accepts everything
+	static Subscription parse(const QByteArray& body);
+
+	// updates the last sent time
+	bool accepts(int typeBit, const QString& eventType, const QString& source);
+	static int getTypeBit(const QString& eventType);    // OtherBit for the unknown types
+
+public:
+	static const int OtherBit = 63;
+
+private:
+	quint64                        typeMask;    // bits of subscribed types
+	QSet<QString>                  otherTypes;  // subscribed types of OtherBit, empty for all
+	QSet<QString>                  teammates;   // empty for all
+	QHash<QString, qint64>         intervals;   // type -> msecs
+	QHash<QPair<QString, QString>, qint64> lastSent;    // (type, source) -> msecs
+};
+
+#endif // Subscription_h__
@@ -1,8 +1,38 @@
 #include "TeamRadarEvent.h"
 #include "MainWnd.h"
+#include "Fields.h"
+#include "Connection.h"
+
+namespace {
+
+const int TimeSize = 19;   // yyyy-MM-dd HH:mm:ss
+
+// user#type#para#time, in one allocation
+// the time is formatted directly, without going through a QString
+QByteArray encode(const char* user, int userSize, const char* type, int typeSize,
+				  const char* para, int paraSize, const QDateTime& time)
+{
+	QByteArray result;
+	result.reserve(userSize + typeSize + paraSize + TimeSize + 3);
+	result.append(user, userSize).append(Connection::Delimiter1)
+		  .append(type, typeSize).append(Connection::Delimiter1)
+		  .append(para, paraSize).append(Connection::Delimiter1);
+	if(!time.isValid())
+		return result;
+
+	QDate d = time.date();
+	QTime t = time.time();
+	char buffer[TimeSize + 1];
+	qsnprintf(buffer, sizeof(buffer), "%04d-%02d-%02d %02d:%02d:%02d",
+			  d.year(), d.month(), d.day(), t.hour(), t.minute(), t.second());
+	result.append(buffer, TimeSize);
+	return result;
+}
+
+}
 
 TeamRadarEvent::TeamRadarEvent(const QString& name, const QString& event, const QString& para, const QString& t)
-: userName(name), eventType(event), parameters(para)
+: userName(name), eventType(event), parameters(para), id(-1)
 {
 	time = t.isEmpty() ? QDateTime::currentDateTime() 
 					   : QDateTime::fromString(t, MainWnd::dateTimeFormat);
@@ -29,3 +59,28 @@ QString TeamRadarEvent::getPhase() const
 bool TeamRadarEvent::operator< (const TeamRadarEvent& other) const {
 	return this->time < other.time;
 }
+
+const QByteArray& TeamRadarEvent::getBody() const
+{
+	if(body.isEmpty())
+	{
+		QByteArray user = userName.toUtf8();
+		QByteArray type = eventType.toUtf8();
+		QByteArray para = parameters.toUtf8();
+		body = encode(user.constData(), user.size(), type.constData(), type.size(),
+					  para.constData(), para.size(), time);
+	}
+	return body;
+}
+
+// the time is the tail of the body, if it has been encoded
+QString TeamRadarEvent::getTimeText() const
+{
+	if(body.isEmpty() || !time.isValid())
+		return time.toString(MainWnd::dateTimeFormat);
+	return QString::fromLatin1(body.constData() + body.size() - TimeSize, TimeSize);
+}
+
+void TeamRadarEvent::setBody(const QByteArray& user, const Field& type, const Field& para) {
+	body = encode(user.constData(), user.size(), type.data, type.size, para.data, para.size, time);
+}
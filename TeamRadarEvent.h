@@ -4,6 +4,9 @@
 #include <QString>
 #include <QDateTime>
 #include <QList>
+#include <QByteArray>
+
+struct Field;
 
 struct TeamRadarEvent
 {
@@ -13,10 +16,23 @@ struct TeamRadarEvent
 	
 	bool operator< (const TeamRadarEvent& other) const;
 
+	// the UTF-8 body of its packets: user#event type#parameters#time
+	// encoded on first use, then shared by all the packets and copies of the event
+	// so the fields must not be changed after that
+	const QByteArray& getBody() const;
+	QString getTimeText() const;    // in MainWnd::dateTimeFormat
+
+	// encodes a body from fields already in UTF-8, e.g., the ones received
+	void setBody(const QByteArray& user, const Field& type, const Field& para);
+
 	QString   userName;
 	QString   eventType;
 	QString   parameters;
 	QDateTime time;
+	int       id;          // ID in Logs, -1 if unknown
+
+private:
+	mutable QByteArray body;   // empty until encoded
 };
 
 typedef QList<TeamRadarEvent> Events;
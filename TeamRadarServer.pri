@@ -0,0 +1,92 @@
+######################################################################
+# The sources of the server, shared by TeamRadarServer.pro and tests/bench/bench.pro
+# Everything but Main.cpp, which is the application's own
+######################################################################
+
+DEPENDPATH += $$PWD
+INCLUDEPATH += $$PWD
+
+QT += sql
+QT += network
+
+# deflate for the clients that ask (Compressor), where zlib is at hand
+# Qt's copy of zlib is not exported on Windows: build with qmake ZLIB_DIR=<zlib install>,
+# or without, and GREETING never offers compression
+unix {
+    DEFINES += HAVE_ZLIB
+    LIBS += -lz
+}
+win32:!isEmpty(ZLIB_DIR) {
+    DEFINES += HAVE_ZLIB
+    INCLUDEPATH += $$ZLIB_DIR/include
+    LIBS += -L$$ZLIB_DIR/lib -lzlib
+}
+
+INCLUDEPATH += $$PWD/../ImageColorBoolModel
+
+HEADERS += $$PWD/Connection.h \
+		   $$PWD/MainWnd.h \
+		   $$PWD/PhaseDivider.h \
+		   $$PWD/Server.h \
+		   $$PWD/Setting.h \
+		   $$PWD/TeamRadarEvent.h \
+		   $$PWD/UsersModel.h \
+		   $$PWD/../ImageColorBoolModel/ImageColorBoolProxy.h \
+		   $$PWD/../ImageColorBoolModel/ImageColorBoolDelegate.h \
+		   $$PWD/../MySetting/MySetting.h \
+		   $$PWD/ConnectionPool.h \
+		   $$PWD/PacketRecorder.h \
+		   $$PWD/Tracer.h \
+		   $$PWD/Subscription.h \
+		   $$PWD/SnapshotCache.h \
+		   $$PWD/EventRing.h \
+		   $$PWD/EventCoalescer.h \
+		   $$PWD/PersistencePolicy.h \
+		   $$PWD/QueryExecutor.h \
+		   $$PWD/Queries.h \
+		   $$PWD/ActivityRollup.h \
+		   $$PWD/PathIndex.h \
+		   $$PWD/LogShards.h \
+		   $$PWD/Fields.h \
+		   $$PWD/CommandHandler.h \
+		   $$PWD/RateLimiter.h \
+		   $$PWD/LoadMonitor.h \
+		   $$PWD/Scheduler.h \
+		   $$PWD/TimerWheel.h \
+		   $$PWD/BufferPool.h \
+		   $$PWD/MemoryUsage.h \
+		   $$PWD/Compressor.h \
+		   $$PWD/Outbox.h \
+		   $$PWD/Cluster.h
+FORMS += $$PWD/MainWnd.ui
+SOURCES += $$PWD/Connection.cpp \
+		   $$PWD/MainWnd.cpp \
+		   $$PWD/PhaseDivider.cpp \
+		   $$PWD/Server.cpp \
+		   $$PWD/Setting.cpp \
+		   $$PWD/TeamRadarEvent.cpp \
+		   $$PWD/UsersModel.cpp \
+		   $$PWD/../ImageColorBoolModel/ImageColorBoolProxy.cpp \
+		   $$PWD/../ImageColorBoolModel/ImageColorBoolDelegate.cpp \
+		   $$PWD/ConnectionPool.cpp \
+		   $$PWD/PacketRecorder.cpp \
+		   $$PWD/Tracer.cpp \
+		   $$PWD/Subscription.cpp \
+		   $$PWD/SnapshotCache.cpp \
+		   $$PWD/EventRing.cpp \
+		   $$PWD/EventCoalescer.cpp \
+		   $$PWD/PersistencePolicy.cpp \
+		   $$PWD/QueryExecutor.cpp \
+		   $$PWD/Queries.cpp \
+		   $$PWD/ActivityRollup.cpp \
+		   $$PWD/PathIndex.cpp \
+		   $$PWD/LogShards.cpp \
+		   $$PWD/Fields.cpp \
+		   $$PWD/RateLimiter.cpp \
+		   $$PWD/LoadMonitor.cpp \
+		   $$PWD/Scheduler.cpp \
+		   $$PWD/TimerWheel.cpp \
+		   $$PWD/BufferPool.cpp \
+		   $$PWD/Compressor.cpp \
+		   $$PWD/Outbox.cpp \
+		   $$PWD/Cluster.cpp
@@ -7,34 +7,11 @@ TARGET =
 DEPENDPATH += . Debug GeneratedFiles
 INCLUDEPATH += .
 
-QT += sql
-QT += network
 RC_FILE = TeamRadarServer.rc
 
-INCLUDEPATH += ../ImageColorBoolModel
+# the sources shared with the bench
+include(TeamRadarServer.pri)
 
 # Input
-HEADERS += Connection.h \
-		   MainWnd.h \
-		   PhaseDivider.h \
-		   Server.h \
-		   Setting.h \
-		   TeamRadarEvent.h \
-		   UsersModel.h \
-		   ../ImageColorBoolModel/ImageColorBoolProxy.h \
-		   ../ImageColorBoolModel/ImageColorBoolDelegate.h \
-		   ../MySetting/MySetting.h \
-    ConnectionPool.h
-FORMS += MainWnd.ui
-SOURCES += Connection.cpp \
-		   Main.cpp \
-		   MainWnd.cpp \
-		   PhaseDivider.cpp \
-		   Server.cpp \
-		   Setting.cpp \
-		   TeamRadarEvent.cpp \
-		   UsersModel.cpp \
-		   ../ImageColorBoolModel/ImageColorBoolProxy.cpp \
-		   ../ImageColorBoolModel/ImageColorBoolDelegate.cpp \
-    ConnectionPool.cpp
+SOURCES += Main.cpp
 RESOURCES += MainWnd.qrc
@@ -0,0 +1,85 @@
+#include "TimerWheel.h"
+
+void TimerWheel::Timer::unlink()
+{
+	if(next == 0)
+		return;
+	prev->next = next;
+	next->prev = prev;
+	prev = next = 0;
+}
+
+void TimerWheel::Timer::linkBefore(Timer* other)
+{
+	prev = other->prev;
+	next = other;
+	prev->next = this;
+	other->prev = this;
+}
+
+TimerWheel::TimerWheel(int msecs, QObject* parent) : QObject(parent)
+{
+	tickMsecs = qMax(msecs, 1);
+	now = 0;
+	for(int i = 0; i < NumSlots; ++i)
+		slots[i].prev = slots[i].next = &slots[i];
+	expired.prev = expired.next = &expired;
+
+	connect(&timer, SIGNAL(timeout()), this, SLOT(tick()));
+	timer.start(tickMsecs);
+}
+
+// the owners of the timers may outlive the wheel
+TimerWheel::~TimerWheel()
+{
+	for(int i = 0; i < NumSlots; ++i)
+		while(slots[i].next != &slots[i])
+			slots[i].next->unlink();
+}
+
+// rounded up to whole ticks, plus one for the part of the current tick already gone,
+// so a timer never fires early, and at most a tick late
+void TimerWheel::start(Timer* t, int msecs)
+{
+	t->unlink();
+	t->deadline = now + (msecs + tickMsecs - 1) / tickMsecs + 1;
+	t->linkBefore(&slots[t->deadline % NumSlots]);
+}
+
+void TimerWheel::stop(Timer* t) {
+	t->unlink();
+}
+
+void TimerWheel::tick()
+{
+	++now;
+
+	// move the due ones out first, as expire() may start or stop any timer
+	Timer& slot = slots[now % NumSlots];
+	for(Timer* t = slot.next; t != &slot; )
+	{
+		Timer* next = t->next;
+		if(t->deadline <= now)   // the others are due in a later revolution
+		{
+			t->unlink();
+			t->linkBefore(&expired);
+		}
+		t = next;
+	}
+
+	while(expired.next != &expired)
+	{
+		Timer* t = expired.next;
+		t->unlink();
+		t->expire();
+	}
+}
+
+int TimerWheel::getNumActive() const
+{
+	int result = 0;
+	for(int i = 0; i < NumSlots; ++i)
+		for(const Timer* t = slots[i].next; t != &slots[i]; t = t->next)
+			++result;
+	return result;
+}
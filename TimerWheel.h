@@ -0,0 +1,58 @@
+#ifndef TimerWheel_h__
+#define TimerWheel_h__
+
+#include <QObject>
+#include <QTimer>
+
+// A hashed timer wheel: the deadlines of all the connections on one Qt timer
+// A deadline is hashed into the slot of its tick, and waits there for the wheel to come around
+// Starting, restarting and stopping a timer are O(1), without touching the Qt timers
+// Each tick only scans the timers in the current slot
+class TimerWheel : public QObject
+{
+	Q_OBJECT
+
+public:
+	// embedded in its owner, and stopped when destroyed
+	class Timer
+	{
+	public:
+		Timer() : prev(0), next(0), deadline(0) {}
+		virtual ~Timer() { unlink(); }
+		bool isActive() const { return next != 0; }
+
+	protected:
+		virtual void expire() {}   // not for the slots
+
+	private:
+		void unlink();
+		void linkBefore(Timer* other);
+
+	private:
+		friend class TimerWheel;
+		Timer* prev;      // circular list, 0 if inactive
+		Timer* next;
+		qint64 deadline;  // in ticks
+	};
+
+public:
+	TimerWheel(int tickMsecs = 1000, QObject* parent = 0);
+	~TimerWheel();
+	void start(Timer* timer, int msecs);   // restarts an active one
+	void stop (Timer* timer);
+	int  getNumActive() const;
+
+public slots:
+	void tick();   // called by the Qt timer, or by tests
+
+private:
+	static const int NumSlots = 64;   // a revolution covers a minute with 1 sec ticks
+
+	QTimer timer;
+	int    tickMsecs;
+	qint64 now;                       // in ticks
+	Timer  slots[NumSlots];           // list heads
+	Timer  expired;                   // being fired
+};
+
+#endif // TimerWheel_h__
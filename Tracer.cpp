@@ -0,0 +1,122 @@
+#include "Tracer.h"
+#include <QThreadStorage>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QFile>
+#include <QTextStream>
+#include <QList>
+
+namespace {
+
+QMutex                           mutex;     // guards buffers & timer
+QList<Tracer::Buffer*>           buffers;   // all threads
+QThreadStorage<Tracer::Buffer*>  localBuffer;
+QThreadStorage<TraceSpan**>      localCurrentSpan;
+QElapsedTimer                    timer;
+
+TraceSpan*& currentSpan()
+{
+	if(!localCurrentSpan.hasLocalData())
+		localCurrentSpan.setLocalData(new TraceSpan*(0));
+	return *localCurrentSpan.localData();
+}
+
+}
+
+void Tracer::start()
+{
+	QMutexLocker locker(&mutex);
+	foreach(Buffer* buffer, buffers)
+		buffer->events.clear();
+	if(!timer.isValid())
+		timer.start();
+	enabled = true;
+}
+
+void Tracer::stop() {
+	enabled = false;
+}
+
+qint64 Tracer::now() {
+	return timer.nsecsElapsed() / 1000;
+}
+
+Tracer::Buffer* Tracer::getBuffer()
+{
+	if(!localBuffer.hasLocalData())
+	{
+		Buffer* buffer = new Buffer;   // owned by the registry, outlives the thread
+		QMutexLocker locker(&mutex);
+		buffer->threadID = buffers.size() + 1;
+		buffers << buffer;
+		localBuffer.setLocalData(buffer);
+	}
+	return localBuffer.localData();
+}
+
+void Tracer::add(const TraceEvent& event)
+{
+	Buffer* buffer = getBuffer();
+	if(buffer->events.size() < MaxEventsPerThread)   // drop when full
+		buffer->events << event;
+}
+
+bool Tracer::dump(const QString& fileName)
+{
+	QFile file(fileName);
+	if(!file.open(QFile::WriteOnly | QFile::Truncate))
+		return false;
+
+	QMutexLocker locker(&mutex);
+	QTextStream os(&file);
+	os << "{\"traceEvents\":[\n";
+	bool first = true;
+	foreach(Buffer* buffer, buffers)
+		foreach(const TraceEvent& event, buffer->events)
+		{
+			if(!first)
+				os << ",\n";
+			first = false;
+			os << "{\"name\":\"" << event.name << "\",\"cat\":\"TeamRadar\",\"ph\":\"X\""
+			   << ",\"ts\":"  << event.start << ",\"dur\":" << event.duration
+			   << ",\"pid\":1,\"tid\":" << buffer->threadID
+			   << ",\"args\":{\"connection\":" << event.connectionID
+			   << ",\"type\":\"" << event.type << "\"}}";
+		}
+	os << "\n]}\n";
+	return true;
+}
+
+volatile bool Tracer::enabled = false;
+
+//////////////////////////////////////////////////////////////////////////
+TraceSpan::TraceSpan(const char* name, quint32 connectionID, const QByteArray& type)
+{
+	active = Tracer::isEnabled();
+	if(!active)
+		return;
+
+	parent = currentSpan();
+	event.name         = name;
+	event.connectionID = connectionID;
+	event.type         = type;
+	if(parent != 0)     // inherit the context
+	{
+		if(connectionID == 0)
+			event.connectionID = parent->event.connectionID;
+		if(type.isEmpty())
+			event.type = parent->event.type;
+	}
+	currentSpan() = this;
+	event.start = Tracer::now();
+}
+
+TraceSpan::~TraceSpan()
+{
+	if(!active)
+		return;
+	event.duration = Tracer::now() - event.start;
+	currentSpan() = parent;
+	Tracer::add(event);
+}
@@ -0,0 +1,65 @@
+#ifndef Tracer_h__
+#define Tracer_h__
+
+#include <QByteArray>
+#include <QVector>
+#include <QString>
+
+// A finished span
+struct TraceEvent
+{
+	const char* name;           // static string
+	qint64      start;          // usecs since the tracer started
+	qint64      duration;       // usecs
+	quint32     connectionID;
+	QByteArray  type;           // message type, e.g. EVENT
+};
+
+// Records spans into thread-local buffers, dumps them as Chrome/Perfetto trace JSON
+// Toggled at runtime; costs one flag test per span when disabled
+class Tracer
+{
+public:
+	static void start();          // clear the buffers and enable
+	static void stop();
+	static bool isEnabled() { return enabled; }
+	static bool dump(const QString& fileName);   // chrome://tracing format
+
+	static qint64 now();          // usecs
+	static void add(const TraceEvent& event);
+
+	struct Buffer
+	{
+		int                 threadID;
+		QVector<TraceEvent> events;
+	};
+
+private:
+	static Buffer* getBuffer();   // of the current thread
+
+public:
+	static const int MaxEventsPerThread = 1000000;
+
+private:
+	static volatile bool enabled;
+};
+
+// RAII span, from construction to destruction
+// connectionID and type are inherited from the enclosing span when omitted
+class TraceSpan
+{
+public:
+	TraceSpan(const char* name, quint32 connectionID = 0, const QByteArray& type = QByteArray());
+	~TraceSpan();
+
+private:
+	TraceSpan(const TraceSpan&);
+	TraceSpan& operator= (const TraceSpan&);
+
+private:
+	bool       active;
+	TraceEvent event;
+	TraceSpan* parent;
+};
+
+#endif // Tracer_h__
@@ -17,12 +17,17 @@ bool UsersModel::openDB(const QString& name)
 		QMessageBox::critical(0, "Error", "Can not open database");
 		return false;
 	}
+	dbName = name;
+
+	// readers on the worker threads do not block the writer
+	QSqlQuery query;
+	query.exec("PRAGMA journal_mode=WAL");
 	return true;
 }
 
-void UsersModel::createTables()
+void UsersModel::createLogTable(QSqlDatabase database)
 {
-	QSqlQuery query;
+	QSqlQuery query(database);
 	query.exec("create table Logs( \
 				ID int primary key, \
 				Time time, \
@@ -30,6 +35,12 @@ void UsersModel::createTables()
 				Event varchar, \
 				Parameters varchar \
 				)");
+}
+
+void UsersModel::createTables()
+{
+	createLogTable(QSqlDatabase::database());
+	QSqlQuery query;
 	query.exec("create table Users( \
 				Username varchar primary key, \
 				Online bool, \
@@ -37,6 +48,31 @@ void UsersModel::createTables()
 				Image varchar, \
 				Project varchar \
 				)");
+
+	// rollups of the events, see ActivityRollup
+	if(query.exec("create table Activity( \
+				   Project varchar, \
+				   Client varchar, \
+				   Event varchar, \
+				   Resolution varchar, \
+				   Bucket varchar, \
+				   Count int, \
+				   primary key (Project, Client, Event, Resolution, Bucket) \
+				   )"))
+	{
+		// new table, backfill from the existing logs
+		// client events are in upper case, unlike the server's own rows (e.g., Connected)
+		query.exec("insert into Activity \
+				   select Project, Client, Event, \"HOUR\", substr(Time, 1, 13), count(*) \
+				   from Logs join Users on Client = Username \
+				   where Event = upper(Event) and Event not in (\"JOINED\", \"DISCONNECTED\") \
+				   group by Project, Client, Event, substr(Time, 1, 13)");
+		query.exec("insert into Activity \
+				   select Project, Client, Event, \"DAY\", substr(Time, 1, 10), count(*) \
+				   from Logs join Users on Client = Username \
+				   where Event = upper(Event) and Event not in (\"JOINED\", \"DISCONNECTED\") \
+				   group by Project, Client, Event, substr(Time, 1, 10)");
+	}
 }
 
 void UsersModel::makeAllOffline()
@@ -133,3 +169,5 @@ QList<QByteArray> UsersModel::getProjectMembers(const QString& project)
 		result << query.value(0).toString().toUtf8();
 	return result;
 }
+
+QString UsersModel::dbName;
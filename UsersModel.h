@@ -11,7 +11,9 @@ public:
 	UsersModel(QObject* parent = 0);
 
 	static bool openDB(const QString& name);
+	static QString getDBName() { return dbName; }
 	static void createTables();
+	static void createLogTable(QSqlDatabase database);   // also of the shards
 	static void makeAllOffline();
 	static void makeOffline(const QString& name);
 	static void makeOnline (const QString& name);
@@ -32,6 +34,9 @@ signals:
 
 public:
 	enum {USERNAME, ONLINE, COLOR, IMAGE};
+
+private:
+	static QString dbName;
 };
 
 #endif // USERSMODEL_H
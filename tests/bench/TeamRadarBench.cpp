@@ -0,0 +1,1791 @@
+#include <QtTest/QtTest>
+#include <QTcpSocket>
+#include <QLocalSocket>
+#include <QBuffer>
+#include <QElapsedTimer>
+#include "Connection.h"
+#include "Fields.h"
+#include "RateLimiter.h"
+#include "LoadMonitor.h"
+#include "TimerWheel.h"
+#include "BufferPool.h"
+#include "Compressor.h"
+#include "Cluster.h"
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#include "Server.h"
+#include "PhaseDivider.h"
+#include "TeamRadarEvent.h"
+#include "EventCoalescer.h"
+#include "PersistencePolicy.h"
+#include "PathIndex.h"
+#include "EventRing.h"
+#include "Queries.h"
+#include "UsersModel.h"
+#include "LogShards.h"
+#include "SnapshotCache.h"
+#include "ActivityRollup.h"
+#include <QSqlDatabase>
+#include <QSqlQuery>
+
+// counts the heap allocations of the process, for the allocations per message
+#ifdef __GLIBC__
+extern "C" void* __libc_malloc (size_t size);
+extern "C" void* __libc_realloc(void* p, size_t size);
+static int numAllocations = 0;
+
+extern "C" void* malloc(size_t size)
+{
+	++numAllocations;
+	return __libc_malloc(size);
+}
+
+extern "C" void* realloc(void* p, size_t size)
+{
+	++numAllocations;
+	return __libc_realloc(p, size);
+}
+#endif
+
+// The wiring before CommandHandler, for comparison:
+// a Receiver with signals, connected to the slots of MainWnd for every connection,
+// and the slots finding the source by sender()
+class Legacy : public QObject
+{
+	Q_OBJECT
+
+public:
+	Legacy() : count(0) {}
+	void wire(Legacy* handler);   // the connects of the old MainWnd::onReadyForUse
+	void dispatch(const QStringList& users, const QStringList& eventTypes,
+				  const QDateTime& startTime, const QDateTime& endTime,
+				  const QStringList& phases, int fuzziness, int pageSize, const QByteArray& token) {
+		emit reqEvents(users, eventTypes, startTime, endTime, phases, fuzziness, pageSize, token);
+	}
+
+signals:
+	void newEvent(const QString&, const QByteArray&);
+	void chatMessage(const QList<QByteArray>&, const QByteArray&);
+	void joinProject(const QString&);
+	void reqTeamMembers();
+	void regPhoto (const QString&, const QByteArray&);
+	void regColor (const QString&, const QByteArray&);
+	void reqOnline(const QString&);
+	void reqPhoto (const QString&);
+	void reqColor (const QString&);
+	void reqEvents(const QStringList&, const QStringList&, const QDateTime&, const QDateTime&,
+				   const QStringList&, int, int, const QByteArray&);
+	void reqTimeSpan();
+	void reqProjects();
+	void reqLocation(const QString&);
+	void reqSnapshot();
+	void reqFileActivity(const QString&, int);
+	void reqActivity(const QDateTime&, const QDateTime&, const QString&, const QStringList&, const QStringList&);
+	void reqBatch(const QList<QByteArray>&);
+
+public slots:
+	void onSignal() {
+		if(qobject_cast<Legacy*>(sender()) != 0)
+			++count;
+	}
+	void onReqEvents(const QStringList&, const QStringList&, const QDateTime&, const QDateTime&,
+					 const QStringList&, int, int, const QByteArray&) {
+		onSignal();
+	}
+
+public:
+	int count;
+};
+
+void Legacy::wire(Legacy* handler)
+{
+	connect(this, SIGNAL(reqTeamMembers()), handler, SLOT(onSignal()));
+	connect(this, SIGNAL(reqTimeSpan()),    handler, SLOT(onSignal()));
+	connect(this, SIGNAL(reqProjects()),    handler, SLOT(onSignal()));
+	connect(this, SIGNAL(newEvent(QString, QByteArray)), handler, SLOT(onSignal()));
+	connect(this, SIGNAL(regPhoto(QString, QByteArray)), handler, SLOT(onSignal()));
+	connect(this, SIGNAL(regColor(QString, QByteArray)), handler, SLOT(onSignal()));
+	connect(this, SIGNAL(reqOnline  (QString)), handler, SLOT(onSignal()));
+	connect(this, SIGNAL(reqPhoto   (QString)), handler, SLOT(onSignal()));
+	connect(this, SIGNAL(reqColor   (QString)), handler, SLOT(onSignal()));
+	connect(this, SIGNAL(reqLocation(QString)), handler, SLOT(onSignal()));
+	connect(this, SIGNAL(reqSnapshot()),        handler, SLOT(onSignal()));
+	connect(this, SIGNAL(reqBatch(QList<QByteArray>)), handler, SLOT(onSignal()));
+	connect(this, SIGNAL(reqFileActivity(QString, int)), handler, SLOT(onSignal()));
+	connect(this, SIGNAL(reqActivity(QDateTime, QDateTime, QString, QStringList, QStringList)),
+			handler, SLOT(onSignal()));
+	connect(this, SIGNAL(reqEvents(QStringList, QStringList, QDateTime, QDateTime, QStringList, int, int, QByteArray)),
+			handler, SLOT(onReqEvents(QStringList, QStringList, QDateTime, QDateTime, QStringList, int, int, QByteArray)));
+	connect(this, SIGNAL(chatMessage(QList<QByteArray>, QByteArray)), handler, SLOT(onSignal()));
+	connect(this, SIGNAL(joinProject(QString)), handler, SLOT(onSignal()));
+}
+
+// A link of limited bandwidth: what is written waits in the "socket" until drained
+class SlowLink : public QIODevice
+{
+public:
+	SlowLink() { open(ReadWrite); }
+	bool   isSequential() const { return true; }
+	qint64 bytesToWrite() const { return pending.size(); }
+	void drain(int max)
+	{
+		QByteArray data = pending.left(max);
+		pending.remove(0, data.size());
+		wire.append(data);
+		emit bytesWritten(data.size());
+	}
+
+	QByteArray wire;   // sent
+
+protected:
+	qint64 readData(char*, qint64) { return 0; }
+	qint64 writeData(const char* data, qint64 size)
+	{
+		pending.append(data, size);
+		return size;
+	}
+
+private:
+	QByteArray pending;
+};
+
+// Micro-benchmarks of the hot helpers
+// All the synthetic data is generated from a fixed seed, so that runs are comparable
+// The bench is the CommandHandler of its server
+class TeamRadarBench : public QObject, public CommandHandler
+{
+	Q_OBJECT
+
+public:
+	TeamRadarBench() : received(0), dispatched(0), disconnections(0), echo(false), requestCost(0), seed(0) {}
+
+	// CommandHandler
+	void onDisconnected(Connection*) { ++disconnections; }
+	void onNewEvent(Connection* source, const QByteArray& message);
+	void onReqEvents(Connection* source, const QStringList&, const QStringList&,
+					 const QDateTime&, const QDateTime&, const QStringList&, int, int, const QByteArray&);
+	void onReqBatch(Connection* source, const QList<QByteArray>& requests);
+
+public slots:
+	void onClusterEvent(const QString& project, const TeamRadarEvent& event);
+	void onClusterDeliver(const QList<QByteArray>& recipients, const QString& source, const QByteArray& packet);
+	void onJobFinished();
+
+private slots:
+	void initTestCase();
+
+	// Sender
+	void makePacket_data();
+	void makePacket();
+	void makeEventPacket_data();
+	void makeEventPacket();
+	void makePhotoReply();
+	void compress_data();
+	void compress();
+
+	// Receiver
+	void fieldToInt_data();
+	void fieldToInt();
+	void guessDataType_data();
+	void guessDataType();
+	void parseReqEvents();
+	void reqEventsPaging();
+	void allocations_data();
+	void allocations();
+	void dispatch_data();
+	void dispatch();
+	void greetFirst();
+	void subscription();
+	void resume();
+	void batch();
+
+	// RateLimiter, LoadMonitor
+	void rateLimit();
+	void shedding();
+
+	// TeamRadarEvent
+	void constructEvent_data();
+	void constructEvent();
+
+	// PhaseDivider
+	void getEvents_data();
+	void getEvents();
+
+	// EventCoalescer
+	void coalesce_data();
+	void coalesce();
+	void coalesceForget();
+
+	// PathIndex
+	void findPath_data();
+	void findPath();
+	void savePath();
+
+	// LogShards, on a main db in a temp dir
+	void logShards();
+
+	// ActivityRollup, ActivityQuery, on a main db in a temp dir
+	void activity();
+
+	// SnapshotCache, QueryExecutor, on a main db in a temp dir
+	void snapshotCache();
+	void queryExecutor();
+
+	// Connection, through a loopback socket
+	void readPackets_data();
+	void readPackets();
+	void roundTrip_data();
+	void roundTrip();
+	void connectStorm_data();
+	void connectStorm();
+	void timers_data();
+	void timers();
+	void reapSilent();
+	void idleConnections();
+	void liveLatency_data();
+	void liveLatency();
+	void chunked_data();
+	void chunked();
+	void cluster();
+	void clusterLiveness();
+	void clusterBehind();
+	void localSocketInUse();
+
+private:
+	void       reseed();
+	int        random(int max);                    // deterministic, in [0, max)
+	QString    randomUser();
+	QString    randomPath();
+	Events     makeHistory(int count);             // synthetic event history
+	QByteArray makeBytes(int size);
+	Connection* connectClient(QIODevice& client);  // TCP or local socket, returns the server side
+	QString    createMainDB();                     // the default connection, in a new temp dir
+	void       removeMainDB(const QString& dir);
+
+private:
+	Server server;
+	int    received;     // number of EVENTs parsed by the server side
+	int    dispatched;   // number of REQ_EVENTS handled
+	int    disconnections;
+	Events clusterEvents;   // received by a node from its peer
+	QList<QByteArray> clusterDelivered;   // recipients, then the packet
+	bool   echo;         // the server side sends the EVENTs back
+	int    requestCost;  // usecs spent on each REQ_EVENTS, as by a real query
+	QStringList requestPhases;   // of the last REQ_EVENTS
+	QList<QByteArray> batchRequests;   // of the last REQ_BATCH
+	QList<Connection*> jobConnections;   // of the finished DBJobs, 0 for the ones gone
+	quint32 seed;
+};
+
+void TeamRadarBench::initTestCase()
+{
+	Receiver::init();
+	RateLimiter::parse("EVENTS=0;CHAT=0;HISTORY=0;PHOTOS=0");   // the benches flood on purpose
+	server.setHandler(this);
+	QVERIFY(server.listen(QHostAddress::LocalHost));
+	QVERIFY(server.listenLocal("TeamRadarBench"));
+}
+
+void TeamRadarBench::onNewEvent(Connection* source, const QByteArray& message)
+{
+	++received;
+	if(echo)
+		source->getSender()->send(Sender::makePacket("EVENT", message));
+}
+
+void TeamRadarBench::onReqEvents(Connection* source, const QStringList&, const QStringList&,
+								 const QDateTime&, const QDateTime&, const QStringList& phases, int, int, const QByteArray&)
+{
+	if(source != 0)
+		++dispatched;
+	requestPhases = phases;
+	QElapsedTimer timer;
+	timer.start();
+	while(timer.nsecsElapsed() < requestCost * 1000) {}
+}
+
+// a reply for each request, but none for the photos, as if there were no photos
+void TeamRadarBench::onReqBatch(Connection* source, const QList<QByteArray>& requests)
+{
+	batchRequests = requests;
+	QList<QByteArray> replies;
+	foreach(const QByteArray& request, requests)
+		replies << (request.startsWith("REQ_PHOTO") ? QByteArray() : Sender::makePacket("REPLY", request));
+	source->getSender()->send(replies);
+}
+
+void TeamRadarBench::onJobFinished()
+{
+	if(DBJob* job = qobject_cast<DBJob*>(sender()))
+		jobConnections << job->getConnection();
+}
+
+void TeamRadarBench::onClusterEvent(const QString&, const TeamRadarEvent& event) {
+	clusterEvents << event;
+}
+
+void TeamRadarBench::onClusterDeliver(const QList<QByteArray>& recipients, const QString&, const QByteArray& packet) {
+	clusterDelivered << recipients << packet;
+}
+
+void TeamRadarBench::reseed() {
+	seed = 20121023;
+}
+
+// LCG, independent of the platform's rand()
+int TeamRadarBench::random(int max)
+{
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 16) % max;
+}
+
+QString TeamRadarBench::randomUser() {
+	return QString("Developer%1").arg(random(50));
+}
+
+QString TeamRadarBench::randomPath() {
+	return QString("TeamRadar/src/module%1/package%2/File%3.java")
+			.arg(random(20)).arg(random(10)).arg(random(100));
+}
+
+Events TeamRadarBench::makeHistory(int count)
+{
+	static const char* modes[] = {"Projects", "Edit", "Design", "Debug"};
+	reseed();
+	Events result;
+	result.reserve(count);
+	QDateTime time = QDateTime::fromString("2012-01-01 08:00:00", MainWnd::dateTimeFormat);
+	for(int i = 0; i < count; ++i)
+	{
+		time = time.addSecs(random(30));
+		TeamRadarEvent event(randomUser(), "SAVE");
+		switch(random(10))
+		{
+		case 0:  event.eventType = "MODE";       event.parameters = modes[random(4)]; break;
+		case 1:  event.eventType = "SCM_COMMIT"; event.parameters = "commit"; break;
+		default: event.parameters = randomPath(); break;
+		}
+		event.time = time;
+		result << event;
+	}
+	return result;
+}
+
+QByteArray TeamRadarBench::makeBytes(int size)
+{
+	reseed();
+	QByteArray result(size, '\0');
+	for(int i = 0; i < size; ++i)
+		result[i] = char(random(256));
+	return result;
+}
+
+void TeamRadarBench::makePacket_data()
+{
+	QTest::addColumn<QByteArray>("body");
+	QTest::newRow("empty") << QByteArray();
+	QTest::newRow("small") << QByteArray("Developer1#SAVE#TeamRadar/src/Main.java");
+	QTest::newRow("1MB")   << makeBytes(1024 * 1024);
+}
+
+void TeamRadarBench::makePacket()
+{
+	QFETCH(QByteArray, body);
+	QBENCHMARK {
+		Sender::makePacket("EVENT", body);
+	}
+}
+
+namespace Before {
+
+QByteArray makePacket(const QByteArray& header, const QList<QByteArray>& bodies)
+{
+	QByteArray joined;
+	foreach(QByteArray body, bodies)
+		joined.append(body + Connection::Delimiter1);
+	joined.chop(1);
+	QByteArray packet(header);
+	packet.append(Connection::Delimiter1);
+	packet.append(QByteArray::number(joined.length()) + Connection::Delimiter1 + joined);
+	return packet;
+}
+
+QByteArray makeEventPacket(const TeamRadarEvent& event, qint64 sequence)
+{
+	QList<QByteArray> bodies;
+	bodies << event.userName.toUtf8()
+		   << event.eventType.toUtf8()
+		   << event.parameters.toUtf8()
+		   << event.time.toString(MainWnd::dateTimeFormat).toUtf8()
+		   << QByteArray::number(sequence);
+	return makePacket("EVENT", bodies);
+}
+
+}
+
+void TeamRadarBench::makeEventPacket_data()
+{
+	QTest::addColumn<bool>("before");
+	QTest::newRow("re-encoded (before)") << true;
+	QTest::newRow("encoded once")        << false;
+}
+
+// relaying a received EVENT: from the bytes on the wire to the packet for the group
+void TeamRadarBench::makeEventPacket()
+{
+	QFETCH(bool, before);
+	QByteArray user("Developer1");
+	QByteArray message("SAVE#TeamRadar/src/module1/package2/Fil\xc3\xa9.java");
+	Fields fields(message, Connection::Delimiter1);
+
+	// same bytes either way
+	TeamRadarEvent event(QString::fromUtf8(user), fields[0].toString(), fields[1].toString());
+	QByteArray expected = Before::makeEventPacket(event, 42);
+	event.setBody(user, fields[0], fields[1]);
+	QCOMPARE(Sender::makeEventPacket(event, 42), expected);
+
+	QBENCHMARK {
+		TeamRadarEvent event(QString::fromUtf8(user), fields[0].toString(), fields[1].toString());
+		if(before)
+			Before::makeEventPacket(event, 42);
+		else
+		{
+			event.setBody(user, fields[0], fields[1]);
+			Sender::makeEventPacket(event, 42);
+		}
+	}
+}
+
+void TeamRadarBench::makePhotoReply()
+{
+	QByteArray photo = makeBytes(1024 * 1024);
+	QBENCHMARK {
+		Sender::makePhotoReply("./Photos/Developer1.png", photo);
+	}
+}
+
+void TeamRadarBench::compress_data()
+{
+	QTest::addColumn<QString>("content");
+	QTest::addColumn<int>("level");
+	QTest::newRow("history, level 1")     << "history" << 1;
+	QTest::newRow("history, level 6")     << "history" << 6;
+	QTest::newRow("photo, level 1")       << "photo"   << 1;
+	QTest::newRow("live events, level 1") << "live"    << 1;
+}
+
+// bytes saved vs. CPU spent, on the packets sent to one client
+void TeamRadarBench::compress()
+{
+#ifndef HAVE_ZLIB
+	QSKIP("built without zlib", SkipAll);
+#else
+	QFETCH(QString, content);
+	QFETCH(int, level);
+	QList<QByteArray> packets;
+	if(content == "history")
+		foreach(const TeamRadarEvent& event, makeHistory(1000))
+			packets << Sender::makeEventsReply(event);
+	else if(content == "photo")   // random, as an already compressed image
+		packets << Sender::makePhotoReply("./Photos/Developer1.png", makeBytes(256 * 1024));
+	else
+		foreach(const TeamRadarEvent& event, makeHistory(1000))
+			packets << Sender::makeEventPacket(event, 1);
+
+	Compressor::setLevel(level);
+	qint64 bytesIn  = 0;
+	qint64 bytesOut = 0;
+	QBENCHMARK {
+		Compressor compressor;   // of a new connection
+		bytesIn = bytesOut = 0;
+		foreach(const QByteArray& packet, packets)
+		{
+			bytesIn  += packet.size();
+			bytesOut += Sender::shouldCompress(packet)
+					  ? Sender::makePacket("Z", compressor.compress(packet)).size() : packet.size();
+		}
+	}
+	qDebug() << content << "level" << level << ":" << bytesIn << "bytes sent as" << bytesOut
+			 << "(" << bytesOut * 100 / qMax(bytesIn, qint64(1)) << "% )";
+
+	// a client inflates them with one stream
+	Compressor compressor;
+	z_stream inflater;
+	memset(&inflater, 0, sizeof(inflater));
+	QCOMPARE(inflateInit(&inflater), Z_OK);
+	foreach(const QByteArray& packet, packets)
+	{
+		QByteArray deflated = compressor.compress(packet);
+		QByteArray inflated(packet.size(), '\0');
+		inflater.next_in   = reinterpret_cast<Bytef*>(deflated.data());
+		inflater.avail_in  = deflated.size();
+		inflater.next_out  = reinterpret_cast<Bytef*>(inflated.data());
+		inflater.avail_out = inflated.size();
+		QVERIFY(inflate(&inflater, Z_SYNC_FLUSH) == Z_OK);
+		QCOMPARE(inflated, packet);
+	}
+	inflateEnd(&inflater);
+	Compressor::setLevel(1);
+#endif
+}
+
+void TeamRadarBench::fieldToInt_data()
+{
+	QTest::addColumn<QByteArray>("text");
+	QTest::addColumn<bool>("valid");
+	QTest::addColumn<int>("value");
+	QTest::newRow("size")          << QByteArray("1024")                 << true  << 1024;
+	QTest::newRow("negative")      << QByteArray("-5")                   << true  << -5;
+	QTest::newRow("not a number")  << QByteArray("12a")                  << false << 0;
+	QTest::newRow("empty")         << QByteArray("")                     << false << 0;
+	QTest::newRow("over INT_MAX")  << QByteArray("4294967306")           << false << 0;   // not 10
+	QTest::newRow("over LLONG_MAX")<< QByteArray("99999999999999999999") << false << 0;
+}
+
+// a size token out of range is an error, not a truncated number
+void TeamRadarBench::fieldToInt()
+{
+	QFETCH(QByteArray, text);
+	QFETCH(bool, valid);
+	QFETCH(int, value);
+	bool ok;
+	QCOMPARE(Field(text.constData(), text.size()).toInt(&ok), value);
+	QCOMPARE(ok, valid);
+}
+
+void TeamRadarBench::guessDataType_data()
+{
+	QTest::addColumn<QByteArray>("header");
+	QTest::newRow("EVENT")           << QByteArray("EVENT#");
+	QTest::newRow("REQ_TEAMMEMBERS") << QByteArray("REQ_TEAMMEMBERS#");
+	QTest::newRow("unknown")         << QByteArray("NO_SUCH_HEADER#");
+}
+
+void TeamRadarBench::guessDataType()
+{
+	QFETCH(QByteArray, header);
+	Receiver receiver(0);
+	QBENCHMARK {
+		receiver.guessDataType(header);
+	}
+}
+
+void TeamRadarBench::parseReqEvents()
+{
+	QByteArray body("Developer1;Developer2;Developer3#SAVE;MODE;SCM_COMMIT#"
+					"2012-01-01 08:00:00;2012-12-31 18:00:00#Coding;Testing#50");
+	Receiver receiver(0);
+	QBENCHMARK {
+		receiver.processData(Receiver::ReqEvents, body);
+	}
+}
+
+// a request without phases is paged by the db, not by loading the whole history
+void TeamRadarBench::reqEventsPaging()
+{
+	Connection connection(new QBuffer, this);
+	connection.setUserName("Pager");
+	connection.setReadyForUse();
+	connection.getReceiver()->processData(Receiver::ReqEvents,
+		"Developer1;Developer2#SAVE#2012-01-01 08:00:00;2012-12-31 18:00:00##50#20");
+	QVERIFY(requestPhases.isEmpty());
+	connection.drop();
+
+	{
+		QSqlDatabase database = QSqlDatabase::addDatabase("QSQLITE", "Paging");
+		database.setDatabaseName(":memory:");
+		QVERIFY(database.open());
+		UsersModel::createLogTable(database);
+		QSqlQuery query(database);
+		query.prepare("insert into Logs values (?, ?, ?, ?, ?)");
+		int id = 0;
+		database.transaction();
+		foreach(const TeamRadarEvent& event, makeHistory(1000))
+		{
+			query.addBindValue(id++);
+			query.addBindValue(event.getTimeText());
+			query.addBindValue("Developer1");
+			query.addBindValue(event.eventType);
+			query.addBindValue(event.parameters);
+			query.exec();
+		}
+		database.commit();
+
+		QDateTime start = QDateTime::fromString("2012-01-01 08:00:00", MainWnd::dateTimeFormat);
+		QDateTime end   = QDateTime::fromString("2012-12-31 18:00:00", MainWnd::dateTimeFormat);
+		EventsQuery job(0, QStringList() << "Developer1", QStringList(), start, end, requestPhases, 50);
+		job.setPage(20, QByteArray(), 1000, 1000000);
+		job.run(database);
+		QCOMPARE(job.getResult().size(), 20);
+		QCOMPARE(job.getNumLoaded(), 21);   // limit + 1, to know there is more
+		QVERIFY(!job.getNextToken().isEmpty());
+	}
+	QSqlDatabase::removeDatabase("Paging");
+}
+
+// the parse path before the Fields and the perfect hash, for comparison
+namespace Before {
+
+QMap<QString, Receiver::DataType> dataTypes;
+
+Receiver::DataType guessDataType(const QByteArray& h)
+{
+	QByteArray header = h;
+	if(header.endsWith('#'))
+		header.chop(1);
+	return dataTypes.contains(header) ? dataTypes[header] : Receiver::Undefined;
+}
+
+void parseReqEvents(const QByteArray& buffer)
+{
+	QList<QByteArray> sections = buffer.split(Connection::Delimiter1);
+	QStringList users  = QString(sections[0]).split(Connection::Delimiter2);
+	QStringList events = QString(sections[1]).split(Connection::Delimiter2);
+	QString startTime  = sections[2].split(Connection::Delimiter2).at(0);
+	QString endTime    = sections[2].split(Connection::Delimiter2).at(1);
+	QStringList phases = QString(sections[3]).split(Connection::Delimiter2);
+	int fuzziness      = sections[4].toInt();
+	QDateTime::fromString(startTime, MainWnd::dateTimeFormat);
+	QDateTime::fromString(endTime,   MainWnd::dateTimeFormat);
+	Q_UNUSED(fuzziness);
+}
+
+}
+
+void TeamRadarBench::allocations_data()
+{
+	QTest::addColumn<bool>("before");
+	QTest::newRow("before") << true;
+	QTest::newRow("after")  << false;
+}
+
+// heap allocations per message, of the header lookup and of parsing a REQ_EVENTS
+void TeamRadarBench::allocations()
+{
+#ifndef __GLIBC__
+	QSKIP("allocations are counted on glibc only", SkipAll);
+#else
+	QFETCH(bool, before);
+	Before::dataTypes.insert("EVENT",      Receiver::Event);
+	Before::dataTypes.insert("REQ_EVENTS", Receiver::ReqEvents);
+
+	const int count = 1000;
+	QByteArray header("EVENT#");
+	QByteArray body("Developer1;Developer2;Developer3#SAVE;MODE;SCM_COMMIT#"
+					"2012-01-01 08:00:00;2012-12-31 18:00:00#Coding;Testing#50");
+	Receiver receiver(0);
+
+	int start = numAllocations;
+	for(int i = 0; i < count; ++i)
+		before ? Before::guessDataType(header) : receiver.guessDataType(header);
+	int headerAllocations = numAllocations - start;
+
+	start = numAllocations;
+	for(int i = 0; i < count; ++i)
+		before ? Before::parseReqEvents(body) : receiver.processData(Receiver::ReqEvents, body);
+	int parseAllocations = numAllocations - start;
+
+	qDebug() << "header lookup:" << double(headerAllocations) / count
+			 << "REQ_EVENTS:"    << double(parseAllocations)  / count << "allocations per message";
+	if(!before)
+		QCOMPARE(headerAllocations, 0);
+#endif
+}
+
+void TeamRadarBench::dispatch_data()
+{
+	QTest::addColumn<bool>("before");
+	QTest::newRow("signal & slot (before)") << true;
+	QTest::newRow("CommandHandler")         << false;
+}
+
+// handing a parsed REQ_EVENTS to its handler
+void TeamRadarBench::dispatch()
+{
+	QFETCH(bool, before);
+	QStringList users  = QStringList() << "Developer1" << "Developer2" << "Developer3";
+	QStringList types  = QStringList() << "SAVE" << "MODE" << "SCM_COMMIT";
+	QStringList phases = QStringList() << "Coding" << "Testing";
+	QDateTime start = QDateTime::fromString("2012-01-01 08:00:00", MainWnd::dateTimeFormat);
+	QDateTime end   = QDateTime::fromString("2012-12-31 18:00:00", MainWnd::dateTimeFormat);
+
+	Legacy handler, receiver;
+	receiver.wire(&handler);
+	Connection connection(new QBuffer, this);
+	CommandHandler* commandHandler = this;
+
+	QBENCHMARK {
+		if(before)
+			receiver.dispatch(users, types, start, end, phases, 50, -1, QByteArray());
+		else
+			commandHandler->onReqEvents(&connection, users, types, start, end, phases, 50, -1, QByteArray());
+	}
+	QVERIFY(handler.count + dispatched > 0);
+}
+
+// a client is served only after it has greeted
+void TeamRadarBench::greetFirst()
+{
+	QBuffer* buffer = new QBuffer;
+	buffer->open(QIODevice::ReadWrite);
+	Connection connection(buffer, this);
+	Receiver* receiver = connection.getReceiver();
+	received = 0;
+	receiver->processData(Receiver::Event, "SAVE#" + randomPath().toUtf8());
+	QCOMPARE(received, 0);
+	QVERIFY(buffer->data().isEmpty());
+
+	receiver->processData(Receiver::Greeting, "Greeter");
+	QVERIFY(connection.isReadyForUse());
+	receiver->processData(Receiver::Event, "SAVE#" + randomPath().toUtf8());
+	QCOMPARE(received, 1);
+	connection.drop();
+}
+
+// the filters of SUBSCRIBE, with the types beyond the known ones
+void TeamRadarBench::subscription()
+{
+	int save  = Subscription::getTypeBit("SAVE");
+	int mode  = Subscription::getTypeBit("MODE");
+	int other = Subscription::getTypeBit("CUSTOM1");
+	QCOMPARE(other, int(Subscription::OtherBit));
+	for(int i = 0; i < 100; ++i)   // unknown types are not registered
+		QCOMPARE(Subscription::getTypeBit(QString("TYPE%1").arg(i)), int(Subscription::OtherBit));
+	QCOMPARE(Subscription::getTypeBit("MODE"), mode);
+
+	Subscription all;
+	QVERIFY(all.accepts(other, "CUSTOM1", "Developer1"));
+
+	Subscription subscription = Subscription::parse("SAVE;CUSTOM1#Developer1;Developer2#SAVE,60000");
+	QVERIFY( subscription.accepts(save,  "SAVE",    "Developer1"));
+	QVERIFY(!subscription.accepts(save,  "SAVE",    "Developer1"));   // within the interval
+	QVERIFY( subscription.accepts(save,  "SAVE",    "Developer2"));   // per teammate
+	QVERIFY(!subscription.accepts(save,  "SAVE",    "Developer3"));   // not a subscribed teammate
+	QVERIFY(!subscription.accepts(mode,  "MODE",    "Developer1"));
+	QVERIFY( subscription.accepts(other, "CUSTOM1", "Developer1"));
+	QVERIFY(!subscription.accepts(other, "CUSTOM2", "Developer1"));   // shares the bit, not the subscription
+
+	Subscription known = Subscription::parse("MODE##");
+	QVERIFY(!known.accepts(other, "CUSTOM1", "Developer1"));
+	QVERIFY( known.accepts(mode,  "MODE",    "Developer1"));
+}
+
+// a resumed client is replayed what the live relay would have sent it
+void TeamRadarBench::resume()
+{
+	QBuffer* buffer = new QBuffer;
+	buffer->open(QIODevice::ReadWrite);
+	Connection connection(buffer, this);
+	connection.getReceiver()->processData(Receiver::Greeting, "Resumer#");   // no sequence: a new session
+	QCOMPARE(connection.getResumeSequence(), qint64(-1));
+	connection.getReceiver()->processData(Receiver::Subscribe, "SAVE##");
+
+	EventRing ring;
+	qint64 lastSeen = ring.lastSequence();
+	ring.append(ring.nextSequence(), "EVENT#1#a", "Resumer",    "SAVE");   // its own
+	ring.append(ring.nextSequence(), "EVENT#1#b", "Developer1", "SAVE");
+	ring.append(ring.nextSequence(), "EVENT#1#c", "Developer1", "MODE");   // not subscribed
+	QList<EventRing::Entry> missed;
+	QVERIFY(ring.getSince(lastSeen, missed));
+	QCOMPARE(missed.size(), 3);
+	QList<QByteArray> replayed;
+	foreach(const EventRing::Entry& entry, missed)
+		if(connection.accepts(entry.source, Subscription::getTypeBit(entry.eventType), entry.eventType))
+			replayed << entry.packet;
+	QCOMPARE(replayed, QList<QByteArray>() << "EVENT#1#b");
+	connection.drop();
+
+	QBuffer* other = new QBuffer;
+	other->open(QIODevice::ReadWrite);
+	Connection resumer(other, this);
+	resumer.getReceiver()->processData(Receiver::Greeting, "Resumer2#42");
+	QCOMPARE(resumer.getResumeSequence(), qint64(42));
+	resumer.drop();
+}
+
+// identical sub-requests of REQ_BATCH are handled once, and the replies are written together
+void TeamRadarBench::batch()
+{
+	QBuffer* buffer = new QBuffer;
+	buffer->open(QIODevice::ReadWrite);
+	Connection connection(buffer, this);
+	Receiver* receiver = connection.getReceiver();
+	receiver->processData(Receiver::Greeting, "Batcher");
+	int greeted = buffer->data().size();
+
+	receiver->processData(Receiver::ReqBatch, "REQ_ONLINE;Developer1#REQ_PHOTO;Developer1#REQ_ONLINE;Developer1#"
+											  "REQ_COLOR;Developer2#REQ_COLOR;Developer2");
+	QCOMPARE(batchRequests, QList<QByteArray>() << "REQ_ONLINE;Developer1" << "REQ_PHOTO;Developer1"
+												<< "REQ_COLOR;Developer2");
+	QCOMPARE(buffer->data().mid(greeted), Sender::makePacket("REPLY", "REQ_ONLINE;Developer1") +
+										  Sender::makePacket("REPLY", "REQ_COLOR;Developer2"));
+
+	// nothing answered, nothing sent
+	int replied = buffer->data().size();
+	receiver->processData(Receiver::ReqBatch, "REQ_PHOTO;Developer3#REQ_PHOTO;Developer3");
+	QCOMPARE(batchRequests, QList<QByteArray>() << "REQ_PHOTO;Developer3");
+	QCOMPARE(buffer->data().size(), replied);
+	connection.drop();
+}
+
+// a plugin flooding EVENTs for a second, at 1 per ms
+void TeamRadarBench::rateLimit()
+{
+	RateLimiter::setLimit(RateLimiter::Events, 50, 200);
+	RateLimiter limiter;
+	int accepted = 0;
+	int notices  = 0;
+	for(qint64 now = 0; now < 1000; ++now)
+		if(limiter.acquire(RateLimiter::Events, now))
+			++accepted;
+		else if(limiter.isNewlyThrottled(RateLimiter::Events))
+			++notices;
+	QCOMPARE(accepted, 200 + 50 - 1);   // the burst, then the rate; the last token is not complete
+	QCOMPARE(notices, 1);
+	QVERIFY(limiter.acquire(RateLimiter::Chat, 0));   // the other classes are not affected
+
+	qint64 now = 1000000;
+	QBENCHMARK {
+		limiter.acquire(RateLimiter::Events, now++);
+	}
+	RateLimiter::setLimit(RateLimiter::Events, 0, 1);
+}
+
+// the expensive requests are shed during a stall, and served again after it
+void TeamRadarBench::shedding()
+{
+	LoadMonitor monitor;
+	monitor.setThreshold(100);
+	for(int i = 0; i < 4; ++i)
+		monitor.addSample(0);
+	QVERIFY(!LoadMonitor::isOverloaded());
+
+	int samples = 0;
+	while(!LoadMonitor::isOverloaded() && samples < 100)
+		monitor.addSample(500), ++samples;   // handlers running 500 ms late
+	QVERIFY(LoadMonitor::isOverloaded());
+
+	monitor.addSample(60);
+	QVERIFY(LoadMonitor::isOverloaded());   // no flapping around the threshold
+	while(LoadMonitor::isOverloaded() && samples < 200)
+		monitor.addSample(0), ++samples;
+	QVERIFY(!LoadMonitor::isOverloaded());
+	monitor.setThreshold(0);
+}
+
+void TeamRadarBench::constructEvent_data()
+{
+	QTest::addColumn<QString>("time");
+	QTest::newRow("now")    << QString();
+	QTest::newRow("parsed") << QString("2012-09-23 10:20:30");
+}
+
+void TeamRadarBench::constructEvent()
+{
+	QFETCH(QString, time);
+	QString user("Developer1");
+	QString type("SAVE");
+	QString path("TeamRadar/src/module1/package2/File3.java");
+	QBENCHMARK {
+		TeamRadarEvent(user, type, path, time);
+	}
+}
+
+void TeamRadarBench::getEvents_data()
+{
+	QTest::addColumn<int>("count");
+	QTest::newRow("100k") << 100000;
+	QTest::newRow("1M")   << 1000000;
+	QTest::newRow("10M")  << 10000000;   // needs a few GB of RAM
+}
+
+void TeamRadarBench::getEvents()
+{
+	QFETCH(int, count);
+	Events history = makeHistory(count);
+	PhaseDivider divider(history, 50);
+	QStringList phases = QStringList() << "Coding" << "Testing" << "Deployment";
+	QBENCHMARK {
+		divider.getEvents(phases);
+	}
+}
+
+void TeamRadarBench::coalesce_data()
+{
+	QTest::addColumn<int>("window");
+	QTest::addColumn<int>("logSampling");
+	QTest::newRow("250ms, log all") << 250  << 1;
+	QTest::newRow("1s, log 1/4")    << 1000 << 4;
+}
+
+static bool earlier(const QPair<qint64, TeamRadarEvent>& lhs, const QPair<qint64, TeamRadarEvent>& rhs) {
+	return lhs.first < rhs.first;
+}
+
+// one hour of 50 developers: bursts of SAVEs (save-on-pause) and MODE switches
+void TeamRadarBench::coalesce()
+{
+	QFETCH(int, window);
+	QFETCH(int, logSampling);
+
+	reseed();
+	QList<QPair<qint64, TeamRadarEvent> > stream;
+	for(qint64 now = 0; now < 3600 * 1000; now += random(100))
+	{
+		TeamRadarEvent event(randomUser(), random(5) == 0 ? "MODE" : "SAVE");
+		int burst = random(4) + 1;
+		for(int i = 0; i < burst; ++i)
+			stream << qMakePair(now + i * random(400), event);
+	}
+	qStableSort(stream.begin(), stream.end(), earlier);
+
+	int numRelayed = 0;
+	int numLogged  = 0;
+	QBENCHMARK {
+		EventCoalescer coalescer;
+		coalescer.setWindow(window);
+		coalescer.setTypes(QStringList() << "SAVE" << "MODE");
+		PersistencePolicy persistence;
+		persistence.setPolicy("SAVE", PersistencePolicy::Sampled, logSampling);
+		persistence.setPolicy("MODE", PersistencePolicy::Sampled, logSampling);
+		numRelayed = numLogged = 0;
+		for(int i = 0; i < stream.size(); ++i)
+		{
+			numRelayed += coalescer.takeDue(stream[i].first).size();
+			if(persistence.shouldPersist(stream[i].second))
+				++numLogged;
+			if(coalescer.submit(stream[i].second, stream[i].first))
+				++numRelayed;
+		}
+		numRelayed += coalescer.takeDue(Q_INT64_C(0x7fffffffffffffff)).size();
+	}
+
+	// each relayed event costs one packet per online teammate
+	const int teammates = 49;
+	qDebug() << "events:"       << stream.size()
+			 << "packets saved:" << qint64(stream.size() - numRelayed) * teammates
+			 << "of"             << qint64(stream.size()) * teammates
+			 << "db writes saved:" << stream.size() - numLogged;
+}
+
+// the held event of a user gone is dropped, and the old deadline does not close a new window
+void TeamRadarBench::coalesceForget()
+{
+	EventCoalescer coalescer;
+	coalescer.setWindow(1000);
+	coalescer.setTypes(QStringList() << "SAVE");
+	TeamRadarEvent save1("Developer1", "SAVE");
+	TeamRadarEvent save2("Developer2", "SAVE");
+	QVERIFY( coalescer.submit(save1, 0));
+	QVERIFY(!coalescer.submit(save1, 100));   // held
+	QVERIFY( coalescer.submit(save2, 100));
+	QVERIFY(!coalescer.submit(save2, 200));
+
+	coalescer.forget("Developer1");
+	QCOMPARE(coalescer.getNumSuperseded(), qint64(1));
+	QVERIFY( coalescer.submit(save1, 500));   // back, in a window of its own
+
+	Events due = coalescer.takeDue(1100);
+	QCOMPARE(due.size(), 1);
+	QCOMPARE(due.first().userName, QString("Developer2"));
+	QVERIFY(!coalescer.submit(save1, 1200));   // still in the new window
+	due = coalescer.takeDue(1500);
+	QCOMPARE(due.size(), 1);
+	QCOMPARE(due.first().userName, QString("Developer1"));
+}
+
+void TeamRadarBench::findPath_data()
+{
+	QTest::addColumn<QString>("prefix");
+	QTest::newRow("project") << QString("TeamRadar");
+	QTest::newRow("module")  << QString("TeamRadar/src/module1");
+	QTest::newRow("file")    << QString("TeamRadar/src/module1/package2/File3.java");
+}
+
+// prefix queries over 1M SAVEs
+void TeamRadarBench::findPath()
+{
+	QFETCH(QString, prefix);
+	PathIndex index;
+	foreach(const TeamRadarEvent& event, makeHistory(1000000))
+		if(event.eventType == "SAVE")
+			index.add("Project", event.userName, event.parameters, event.time);
+
+	QBENCHMARK {
+		index.find("Project", prefix);
+	}
+}
+
+// the counts survive a restart, of a path that is also a prefix of another, and of a project with a '/'
+void TeamRadarBench::savePath()
+{
+	QDateTime time = QDateTime::currentDateTime();
+	PathIndex index;
+	index.add("Team/Radar", "Developer1", "src/a", time);
+	index.add("Team/Radar", "Developer1", "src/a/B.java", time);
+	index.add("Team/Radar", "Developer2", "src/a/B.java", time);
+	index.add("Team", "Developer3", "Radar/src/a", time);
+	QVERIFY(index.save("PathIndexBench.dat"));
+
+	PathIndex loaded;
+	QVERIFY(loaded.load("PathIndexBench.dat"));
+	QFile::remove("PathIndexBench.dat");
+	foreach(const QString& prefix, QStringList() << "src" << "src/a" << "src/a/B.java")
+	{
+		PathIndex::Users before = index.find("Team/Radar", prefix);
+		PathIndex::Users after  = loaded.find("Team/Radar", prefix);
+		QCOMPARE(after.size(), before.size());
+		for(PathIndex::Users::ConstIterator it = before.begin(); it != before.end(); ++it)
+			QCOMPARE(after.value(it.key()).count, it.value().count);
+	}
+	QCOMPARE(loaded.find("Team/Radar", "src/a").value("Developer1").count, quint32(2));
+	QCOMPARE(QStringList(loaded.find("Team", "Radar/src/a").keys()), QStringList() << "Developer3");
+	QCOMPARE(loaded.getLatest().toTime_t(), time.toTime_t());   // where the backfill catches up
+
+	// a rename merges the entries of the two names
+	loaded.rename("Developer2", "Developer1");
+	QCOMPARE(QStringList(loaded.find("Team/Radar", "src/a/B.java").keys()), QStringList() << "Developer1");
+	QCOMPARE(loaded.find("Team/Radar", "src/a/B.java").value("Developer1").count, quint32(2));
+	QCOMPARE(loaded.find("Team/Radar", "src").value("Developer1").count, quint32(3));
+	QVERIFY(loaded.save("PathIndexBench.dat"));
+	QVERIFY(!QFile::exists("PathIndexBench.dat.tmp"));
+
+	// a truncated file loads nothing, not a part of it
+	QFile file("PathIndexBench.dat");
+	QVERIFY(file.resize(file.size() / 2));
+	QVERIFY(!loaded.load("PathIndexBench.dat"));
+	QFile::remove("PathIndexBench.dat");
+	QVERIFY(loaded.find("Team/Radar", "src").isEmpty());
+	QVERIFY(loaded.getLatest().isNull());
+}
+
+// connect a client to the server, and greet
+Connection* TeamRadarBench::connectClient(QIODevice& client)
+{
+	QSignalSpy spy(&server, SIGNAL(newConnection(Connection*)));
+	if(QTcpSocket* socket = qobject_cast<QTcpSocket*>(&client))
+	{
+		socket->connectToHost(server.serverAddress(), server.serverPort());
+		if(!socket->waitForConnected(5000))
+			return 0;
+	}
+	else if(QLocalSocket* socket = qobject_cast<QLocalSocket*>(&client))
+	{
+		socket->connectToServer(server.getLocalName());
+		if(!socket->waitForConnected(5000))
+			return 0;
+	}
+	for(int i = 0; i < 100 && spy.isEmpty(); ++i)
+		QTest::qWait(10);
+	if(spy.isEmpty())
+		return 0;
+
+	Connection* connection = server.findChildren<Connection*>().last();
+	static int clients = 0;   // user names must be unique
+	client.write(Sender::makePacket("GREETING", "Bench" + QByteArray::number(++clients)));
+	for(int i = 0; i < 500 && client.bytesAvailable() == 0; ++i)   // GREETING reply
+		QTest::qWait(10);   // the server side runs in this thread, do not block it
+	client.readAll();
+	return connection;
+}
+
+void TeamRadarBench::readPackets_data()
+{
+	QTest::addColumn<int>("count");
+	QTest::addColumn<int>("size");
+	QTest::newRow("1000 small events") << 1000 << 0;
+	QTest::newRow("10 1MB events")     << 10   << 1024 * 1024;
+}
+
+// framing of inbound packets by Connection (readDataIntoBuffer & co.)
+void TeamRadarBench::readPackets()
+{
+	QFETCH(int, count);
+	QFETCH(int, size);
+
+	QTcpSocket client;
+	Connection* connection = connectClient(client);
+	QVERIFY(connection != 0);
+
+	QByteArray parameters = size > 0 ? makeBytes(size) : randomPath().toUtf8();
+	QByteArray packet = Sender::makePacket("EVENT", "SAVE#" + parameters);
+	QByteArray stream;
+	for(int i = 0; i < count; ++i)
+		stream.append(packet);
+
+	QBENCHMARK {
+		received = 0;
+		client.write(stream);
+		client.flush();
+		while(received < count && client.state() == QAbstractSocket::ConnectedState)
+			QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+	}
+	QCOMPARE(received, count);
+	client.disconnectFromHost();
+}
+
+void TeamRadarBench::connectStorm_data()
+{
+	QTest::addColumn<bool>("before");
+	QTest::newRow("17 connects per connection (before)") << true;
+	QTest::newRow("CommandHandler")                      << false;
+}
+
+// setting up 1000 connections at once, e.g., when the clients come back after a restart
+void TeamRadarBench::connectStorm()
+{
+	QFETCH(bool, before);
+	const int count = 1000;
+	Legacy handler;
+	QBENCHMARK {
+		QList<QObject*> objects;
+		for(int i = 0; i < count; ++i)
+		{
+			objects << new Connection(new QBuffer, this);
+			if(before)
+			{
+				Legacy* receiver = new Legacy;
+				receiver->wire(&handler);
+				objects << receiver;
+			}
+		}
+		qDeleteAll(objects);
+	}
+}
+
+void TeamRadarBench::roundTrip_data()
+{
+	QTest::addColumn<bool>("local");
+	QTest::newRow("TCP loopback") << false;
+	QTest::newRow("local socket") << true;
+}
+
+// latency of a small EVENT and its echo, the client and the server in one event loop
+void TeamRadarBench::roundTrip()
+{
+	QFETCH(bool, local);
+
+	QTcpSocket   tcpClient;
+	QLocalSocket localClient;
+	QIODevice& client = local ? static_cast<QIODevice&>(localClient) : tcpClient;
+	QVERIFY(connectClient(client) != 0);
+
+	QByteArray packet = Sender::makePacket("EVENT", "SAVE#" + randomPath().toUtf8());
+	echo = true;
+	QBENCHMARK {
+		client.write(packet);
+		while(client.bytesAvailable() < packet.size())
+			QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+		client.read(packet.size());
+	}
+	echo = false;
+	client.close();
+}
+
+void TeamRadarBench::timers_data()
+{
+	QTest::addColumn<bool>("before");
+	QTest::newRow("Qt timer per connection (before)") << true;
+	QTest::newRow("timer wheel")                      << false;
+}
+
+// restarting the transfer deadlines of 1000 connections, as each read did
+void TeamRadarBench::timers()
+{
+	QFETCH(bool, before);
+	const int count = 1000;
+	QObject object;
+	QVector<int> ids(count, 0);
+	TimerWheel wheel;
+	TimerWheel::Timer* deadlines = new TimerWheel::Timer[count];
+
+	QBENCHMARK {
+		for(int i = 0; i < count; ++i)
+			if(before)
+			{
+				if(ids[i] != 0)
+					object.killTimer(ids[i]);
+				ids[i] = object.startTimer(Connection::TransferTimeout);
+			}
+			else
+				wheel.start(&deadlines[i], Connection::TransferTimeout);
+	}
+
+	foreach(int id, ids)
+		if(id != 0)
+			object.killTimer(id);
+	delete[] deadlines;
+}
+
+// a keepalive client that stops answering is pinged, then dropped
+void TeamRadarBench::reapSilent()
+{
+	TimerWheel wheel(1000);
+	Connection::setKeepAliveTimes(2000, 1000);
+	QBuffer* buffer = new QBuffer;
+	buffer->open(QIODevice::ReadWrite);
+	Connection connection(buffer, this);
+	connection.setTimerWheel(&wheel);
+	connection.setKeepAlive();   // as after its PING
+	disconnections = 0;
+
+	wheel.tick();
+	wheel.tick();
+	QVERIFY(buffer->data().isEmpty());   // not early, however close to a tick it was started
+	wheel.tick();                // silent for the interval
+	QCOMPARE(buffer->data(), QByteArray("PING#0#"));
+	wheel.tick();
+	QCOMPARE(disconnections, 0);
+	wheel.tick();                // and for the timeout
+	QCOMPARE(disconnections, 1);
+	QCOMPARE(wheel.getNumActive(), 0);
+	Connection::setKeepAliveTimes(60 * 1000, 30 * 1000);
+}
+
+// resident memory of the process, 0 if unknown
+static qint64 getResidentBytes()
+{
+	QFile file("/proc/self/statm");
+	if(!file.open(QFile::ReadOnly))
+		return 0;
+	QList<QByteArray> fields = file.readAll().split(' ');
+	return fields.size() > 1 ? fields[1].toLongLong() * 4096 : 0;
+}
+
+// 10k idle connections: what they cost, and the budget dropping them
+// over in-memory devices, so the kernel side of the sockets is not included
+void TeamRadarBench::idleConnections()
+{
+	const int count = 10000;
+	Server local;
+	qint64 residentBefore = getResidentBytes();
+	for(int i = 0; i < count; ++i)
+	{
+		QBuffer* buffer = new QBuffer;
+		buffer->open(QIODevice::ReadWrite);
+		new Connection(buffer, this, &local);
+	}
+	qint64 resident = getResidentBytes() - residentBefore;
+
+	QElapsedTimer timer;
+	timer.start();
+	QMetaObject::invokeMethod(&local, "onCheckMemory");
+	qint64 checkTime = timer.elapsed();
+
+	MemoryUsage usage = local.getMemoryUsage();
+	qDebug() << "per idle connection, bytes: estimated" << usage.getTotal() / count
+			 << "measured" << (resident > 0 ? resident / count : -1)
+			 << "; checking" << count << "connections:" << checkTime << "ms";
+	QCOMPARE(local.getNumConnections(), count);
+	QCOMPARE(usage.buffers, qint64(0));   // idle connections hold no receive buffers
+	QCOMPARE(usage.output,  qint64(0));
+
+	// half of it
+	disconnections = 0;
+	local.setMemoryBudget(usage.getTotal() / 2);
+	QMetaObject::invokeMethod(&local, "onCheckMemory");
+	QVERIFY(local.getNumShed() >= count / 2);
+	QCOMPARE(disconnections, int(local.getNumShed()));
+}
+
+void TeamRadarBench::liveLatency_data()
+{
+	QTest::addColumn<int>("sliceSize");
+	QTest::newRow("drained (before)") << 0;
+	QTest::newRow("sliced")           << 16;
+}
+
+// round trips of live EVENTs, while another client pipelines a history burst
+void TeamRadarBench::liveLatency()
+{
+	QFETCH(int, sliceSize);
+	server.getScheduler()->setSliceSize(sliceSize);
+
+	QTcpSocket bulkClient;
+	QTcpSocket liveClient;
+	QVERIFY(connectClient(bulkClient) != 0);
+	QVERIFY(connectClient(liveClient) != 0);
+
+	const int count = 2000;
+	QByteArray request = Sender::makePacket("REQ_EVENTS", "Developer1#SAVE#"
+											"2012-01-01 08:00:00;2012-12-31 18:00:00#Coding#50");
+	QByteArray burst;
+	for(int i = 0; i < count; ++i)
+		burst.append(request);
+	QByteArray event = Sender::makePacket("EVENT", "SAVE#" + randomPath().toUtf8());
+
+	echo        = true;
+	requestCost = 100;
+	dispatched  = 0;
+	QList<qint64> latencies;   // usecs
+	QElapsedTimer timer;
+	bulkClient.write(burst);
+	bulkClient.flush();
+	while(dispatched < count)
+	{
+		timer.start();
+		liveClient.write(event);
+		liveClient.flush();
+		while(liveClient.bytesAvailable() < event.size())
+			QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+		liveClient.read(event.size());
+		latencies << timer.nsecsElapsed() / 1000;
+	}
+	echo        = false;
+	requestCost = 0;
+	server.getScheduler()->setSliceSize(16);
+
+	qSort(latencies);
+	qDebug() << "live EVENT round trip, usecs: p50" << latencies[latencies.size() / 2]
+			 << "p99" << latencies[latencies.size() * 99 / 100]
+			 << "max" << latencies.last() << "of" << latencies.size();
+	bulkClient.close();
+	liveClient.close();
+}
+
+void TeamRadarBench::chunked_data()
+{
+	QTest::addColumn<bool>("chunked");
+	QTest::newRow("whole packets (legacy client)") << false;
+	QTest::newRow("chunked")                       << true;
+}
+
+// the packets on the wire, in the order completed, with the chunks of each lane joined
+static QList<QByteArray> receivePackets(const QByteArray& wire)
+{
+	QList<QByteArray> result;
+	QByteArray parts[Outbox::NumLanes];
+	int pos = 0;
+	while(pos < wire.size())
+	{
+		int headerEnd = wire.indexOf(Connection::Delimiter1, pos);
+		int sizeEnd   = wire.indexOf(Connection::Delimiter1, headerEnd + 1);
+		int size      = wire.mid(headerEnd + 1, sizeEnd - headerEnd - 1).toInt();
+		QByteArray packet = wire.mid(pos, sizeEnd + 1 + size - pos);
+		pos += packet.size();
+		if(!packet.startsWith("CHUNK#"))
+		{
+			result << packet;
+			continue;
+		}
+		QByteArray body = wire.mid(sizeEnd + 1, size);   // lane#more#data
+		int lane = body[0] - '0';
+		parts[lane].append(body.mid(4));
+		if(body[2] == '0')
+		{
+			result << parts[lane];
+			parts[lane].clear();
+		}
+	}
+	return result;
+}
+
+// how much of two photos a live EVENT sent after them waits behind
+void TeamRadarBench::chunked()
+{
+	QFETCH(bool, chunked);
+	SlowLink* link = new SlowLink;
+	Connection connection(link, this);
+	connection.getOutbox()->setChunked(chunked);
+	connection.setUserName("ChunkedClient");
+	connection.setReadyForUse();
+
+	QByteArray photo = Sender::makePhotoReply("./Photos/Developer1.png", makeBytes(1024 * 1024));
+	QByteArray event = Sender::makePacket("EVENT", "Developer2#SAVE#" + randomPath().toUtf8());
+	connection.getSender()->send(photo);
+	connection.getSender()->send(photo);
+	connection.getSender()->send(event);
+	while(link->wire.indexOf(event) < 0 && link->bytesToWrite() > 0)
+		link->drain(4096);
+	int ahead = link->wire.indexOf(event);
+	while(link->bytesToWrite() > 0)
+		link->drain(64 * 1024);
+
+	qDebug() << "bytes ahead of the EVENT:" << ahead << "," << ahead / 1000 << "ms at 1MB/s";
+	QVERIFY(connection.getOutbox()->isEmpty());
+	QList<QByteArray> packets = receivePackets(link->wire);
+	QCOMPARE(packets.size(), 3);
+	QVERIFY(packets.count(photo) == 2);
+	if(chunked)
+	{
+		QCOMPARE(packets.first(), event);
+		QVERIFY(ahead <= 2 * Outbox::getChunkSize());
+	}
+	else
+		QVERIFY(ahead < 2 * photo.size());   // the second photo is passed
+	connection.drop();
+}
+
+// processes events until the condition holds, false on timeout
+#define WAIT_FOR(condition) \
+	{ \
+		QElapsedTimer waited; \
+		waited.start(); \
+		while(!(condition) && waited.elapsed() < 5000) \
+			QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents, 100); \
+	}
+
+// two nodes in one process, linked over loopback as two processes are
+void TeamRadarBench::cluster()
+{
+	Cluster nodeA, nodeB;
+	nodeA.setName("A");
+	nodeB.setName("B");
+	QVERIFY(nodeA.listen(12401));
+	QVERIFY(nodeB.listen(12402));
+	nodeA.setPeers(QStringList() << "127.0.0.1:12402");
+	nodeB.setPeers(QStringList() << "127.0.0.1:12401");
+	connect(&nodeB, SIGNAL(eventReceived(QString, TeamRadarEvent)), this, SLOT(onClusterEvent(QString, TeamRadarEvent)));
+	connect(&nodeB, SIGNAL(deliverReceived(QList<QByteArray>, QString, QByteArray)),
+			this, SLOT(onClusterDeliver(QList<QByteArray>, QString, QByteArray)));
+	WAIT_FOR(nodeA.getNumPeers() == 1 && nodeB.getNumPeers() == 1)
+	QCOMPARE(nodeA.getNumPeers(), 1);
+
+	// membership
+	nodeB.join("Developer2", "TeamRadar");
+	WAIT_FOR(nodeA.isOnline("Developer2"))
+	QCOMPARE(nodeA.getMembers("TeamRadar"), QStringList() << "Developer2");
+	QVERIFY(nodeA.getMembers("Other").isEmpty());
+
+	// events cross only to the nodes with members of their projects
+	const int count = 1000;
+	Events history = makeHistory(count);
+	clusterEvents.clear();
+	qint64 skipped = nodeA.getNumSkipped();
+	nodeA.relayEvent("Other", history.first());
+	QCOMPARE(nodeA.getNumSkipped(), skipped + 1);
+
+	QElapsedTimer timer;
+	timer.start();
+	foreach(const TeamRadarEvent& event, history)
+		nodeA.relayEvent("TeamRadar", event);
+	WAIT_FOR(clusterEvents.size() == count)
+	qDebug() << count << "events relayed between nodes in" << timer.elapsed() << "ms";
+	QCOMPARE(clusterEvents.size(), count);
+	QCOMPARE(clusterEvents.last().getBody(), history.last().getBody());
+
+	// chat goes only to the recipients on the peer
+	QByteArray chat = Sender::makeChatPacket("Developer1", "hello");
+	clusterDelivered.clear();
+	nodeA.deliver(QList<QByteArray>() << "Developer2" << "Developer3", "Developer1", chat);
+	WAIT_FOR(!clusterDelivered.isEmpty())
+	QCOMPARE(clusterDelivered, QList<QByteArray>() << "Developer2" << chat);
+
+	nodeB.leave("Developer2");
+	WAIT_FOR(!nodeA.isOnline("Developer2"))
+	QVERIFY(nodeA.getMembers("TeamRadar").isEmpty());
+}
+
+// a peer is dropped when it goes silent, and the late close of a replaced link changes nothing
+void TeamRadarBench::clusterLiveness()
+{
+	Cluster node;
+	node.setName("A");
+	node.setHeartbeatInterval(500);
+	QVERIFY(node.listen(12403));
+
+	// peer C, by hand
+	QTcpSocket first;
+	first.connectToHost("127.0.0.1", 12403);
+	QVERIFY(first.waitForConnected(5000));
+	first.write(Sender::makePacket("NODE", "C") + Sender::makePacket("JOIN", "TeamRadar#Developer3"));
+	WAIT_FOR(node.isOnline("Developer3"))
+	QVERIFY(node.isOnline("Developer3"));
+
+	// C relinks, before its old link is closed
+	QTcpSocket second;
+	second.connectToHost("127.0.0.1", 12403);
+	QVERIFY(second.waitForConnected(5000));
+	second.write(Sender::makePacket("NODE", "C") + Sender::makePacket("JOIN", "TeamRadar#Developer4"));
+	WAIT_FOR(node.isOnline("Developer4") && first.state() == QAbstractSocket::UnconnectedState)
+	QCOMPARE(first.state(), QAbstractSocket::UnconnectedState);
+	QCOMPARE(node.getMembers("TeamRadar"), QStringList() << "Developer4");
+
+	// then C goes silent, as if crashed
+	WAIT_FOR(!node.isOnline("Developer4") && second.state() == QAbstractSocket::UnconnectedState)
+	QVERIFY(!node.isOnline("Developer4"));
+	QCOMPARE(second.state(), QAbstractSocket::UnconnectedState);
+}
+
+// a peer too far behind is dropped, while the relay is walking the peers
+void TeamRadarBench::clusterBehind()
+{
+	Cluster node;
+	node.setName("A");
+	QVERIFY(node.listen(12404));
+
+	// peer C, by hand, never reading
+	QTcpServer peer;
+	QVERIFY(peer.listen(QHostAddress::LocalHost, 12405));
+	node.setPeers(QStringList() << "127.0.0.1:12405");
+	WAIT_FOR(peer.hasPendingConnections())
+	QTcpSocket* route = peer.nextPendingConnection();
+	QVERIFY(route != 0);
+	route->write(Sender::makePacket("NODE", "C"));
+	QTcpSocket told;
+	told.connectToHost("127.0.0.1", 12404);
+	QVERIFY(told.waitForConnected(5000));
+	told.write(Sender::makePacket("NODE", "C") + Sender::makePacket("JOIN", "TeamRadar#Developer5"));
+	WAIT_FOR(node.getNumPeers() == 1 && node.isOnline("Developer5"))
+	QVERIFY(node.isOnline("Developer5"));
+
+	// queued without returning to the event loop, so past MaxBacklog
+	TeamRadarEvent event("Developer1", "SAVE", QString(1024 * 1024, 'x'));
+	for(int i = 0; i < 40; ++i)
+		node.relayEvent("TeamRadar", event);
+	WAIT_FOR(!node.isOnline("Developer5"))
+	QVERIFY(!node.isOnline("Developer5"));
+	QCOMPARE(node.getNumPeers(), 0);
+}
+
+QString TeamRadarBench::createMainDB()
+{
+	QString dir = QDir::tempPath() + QString("/TeamRadarBench%1").arg(QDateTime::currentMSecsSinceEpoch());
+	QDir().mkpath(dir);
+	if(!UsersModel::openDB(dir + "/TeamRadar.db"))
+		return QString();
+	UsersModel::createTables();
+	return dir;
+}
+
+void TeamRadarBench::removeMainDB(const QString& dir)
+{
+	QSqlDatabase::removeDatabase(QSqlDatabase::defaultConnection);
+	foreach(const QString& subDir, QStringList() << "/Shards" << "")
+	{
+		foreach(const QString& fileName, QDir(dir + subDir).entryList(QDir::Files))
+			QFile::remove(dir + subDir + "/" + fileName);
+		QDir().rmdir(dir + subDir);
+	}
+}
+
+namespace {
+
+// the events of Developer1 in the db it is run on
+class CountJob : public DBJob
+{
+public:
+	CountJob(QAtomicInt* c, Connection* connection = 0) : DBJob(connection), count(c) {}
+	void run(QSqlDatabase& database)
+	{
+		QSqlQuery query(database);
+		query.exec("select count(*) from Logs where Client = 'Developer1'");
+		count->fetchAndStoreOrdered(query.next() ? query.value(0).toInt() : -1);
+	}
+
+private:
+	QAtomicInt* count;
+};
+
+}
+
+// a new shard takes all the events of its project from the main db, or none
+void TeamRadarBench::logShards()
+{
+	QString dir = createMainDB();
+	QVERIFY(!dir.isEmpty());
+	UsersModel::addUser("Developer1");
+	UsersModel::setProject("Developer1", "TeamRadar");
+	UsersModel::addUser("Developer2");
+	UsersModel::setProject("Developer2", "Broken");
+	UsersModel::addUser("Developer3");   // no project
+	{
+		QSqlQuery query;
+		query.prepare("insert into Logs values (?, ?, ?, ?, ?)");
+		for(int id = 0; id < 300; ++id)
+		{
+			query.addBindValue(id);
+			query.addBindValue("2012-01-01 08:00:00");
+			query.addBindValue(QString("Developer%1").arg(id % 3 + 1));
+			query.addBindValue("SAVE");
+			query.addBindValue(randomPath());
+			QVERIFY(query.exec());
+		}
+
+		// a shard that cannot take them
+		QDir().mkpath(dir + "/Shards");
+		QSqlDatabase database = QSqlDatabase::addDatabase("QSQLITE", "Broken");
+		database.setDatabaseName(dir + "/Shards/Broken.db");
+		QVERIFY(database.open());
+		QVERIFY(QSqlQuery(database).exec("create view Logs as select 1 as ID"));
+	}
+	QSqlDatabase::removeDatabase("Broken");
+
+	{
+		QueryExecutor executor;
+		executor.setDatabaseName(dir + "/TeamRadar.db");
+		LogShards shards;
+		shards.setDir(dir + "/Shards");
+		shards.setMainExecutor(&executor);
+		QSignalSpy created(&shards, SIGNAL(shardCreated(QString)));
+
+		// logged in the main db during the first move, and read after both
+		QVERIFY(!shards.isSharded("TeamRadar"));
+		QVERIFY(QSqlQuery().exec("insert into Logs values (300, '2012-01-01 09:00:00', 'Developer1', 'SAVE', 'Late.java')"));
+		QAtomicInt counted(-1);
+		shards.submit("TeamRadar", new CountJob(&counted));
+		WAIT_FOR(created.count() == 1 && counted != -1)
+		QCOMPARE(created.count(), 1);
+		QCOMPARE(int(counted), 101);
+		QVERIFY(shards.isSharded("TeamRadar"));
+
+		QSqlQuery query(shards.getDatabase("TeamRadar"));
+		QVERIFY(query.exec("select count(*) from Logs") && query.next());
+		QCOMPARE(query.value(0).toInt(), 101);
+		QSqlQuery main;
+		QVERIFY(main.exec("select count(*) from Logs where Client = 'Developer1'") && main.next());
+		QCOMPARE(main.value(0).toInt(), 0);
+
+		// rolled back, the project stays in the main db
+		QVERIFY(!shards.isSharded("Broken"));
+		WAIT_FOR(shards.getNumOpen() == 1)
+		QCOMPARE(shards.getNumOpen(), 1);
+		QVERIFY(!shards.isSharded("Broken"));
+		QVERIFY(main.exec("select count(*) from Logs where Client = 'Developer2'") && main.next());
+		QCOMPARE(main.value(0).toInt(), 100);
+		QCOMPARE(created.count(), 1);
+	}
+	removeMainDB(dir);
+}
+
+// the counts are backfilled from the logs, rolled up per hour & day, and follow a rename
+void TeamRadarBench::activity()
+{
+	QString dir = createMainDB();
+	QVERIFY(!dir.isEmpty());
+	UsersModel::addUser("Developer1");
+	UsersModel::setProject("Developer1", "TeamRadar");
+	UsersModel::addUser("Developer2");
+	UsersModel::setProject("Developer2", "TeamRadar");
+	{
+		QSqlQuery query;
+		QVERIFY(query.exec("insert into Logs values (0, '2012-01-01 08:10:00', 'Developer1', 'SAVE', 'A.java')"));
+		QVERIFY(query.exec("insert into Logs values (1, '2012-01-01 08:50:00', 'Developer1', 'SAVE', 'B.java')"));
+		QVERIFY(query.exec("insert into Logs values (2, '2012-01-01 09:10:00', 'Developer1', 'SAVE', 'A.java')"));
+		QVERIFY(query.exec("insert into Logs values (3, '2012-01-01 09:20:00', 'Developer1', 'Connected', '')"));
+		QVERIFY(query.exec("drop table Activity"));
+	}
+	UsersModel::createTables();   // a new table is backfilled, without the server's own rows
+
+	QSqlDatabase database = QSqlDatabase::database();
+	ActivityQuery backfilled(0, "TeamRadar", QDateTime(), QDateTime(), "HOUR", QStringList(), QStringList());
+	backfilled.run(database);
+	QCOMPARE(backfilled.getResult(), QList<QByteArray>() << "Developer1;SAVE;2012-01-01 08;2"
+														 << "Developer1;SAVE;2012-01-01 09;1");
+
+	// the pending counts are flushed before a rename, and merged into the counts of the new name
+	{
+		ActivityRollup rollup;
+		QDateTime time = QDateTime::fromString("2012-01-01 09:40:00", "yyyy-MM-dd HH:mm:ss");
+		rollup.add("TeamRadar", "Developer1", "SAVE", time);
+		rollup.add("TeamRadar", "Developer2", "SAVE", time.addSecs(30 * 60));
+		rollup.rename("Developer1", "Developer3");
+		rollup.rename("Developer2", "Developer3");
+	}
+
+	ActivityQuery hours(0, "TeamRadar", QDateTime(), QDateTime(), "HOUR", QStringList(), QStringList());
+	hours.run(database);
+	QCOMPARE(hours.getResult(), QList<QByteArray>() << "Developer3;SAVE;2012-01-01 08;2"
+													<< "Developer3;SAVE;2012-01-01 09;2"
+													<< "Developer3;SAVE;2012-01-01 10;1");
+	ActivityQuery days(0, "TeamRadar", QDateTime(), QDateTime(), "DAY", QStringList(), QStringList());
+	days.run(database);
+	QCOMPARE(days.getResult(), QList<QByteArray>() << "Developer3;SAVE;2012-01-01;5");
+
+	// REQ_ACTIVITY of a time span, and of a user
+	QDateTime start = QDateTime::fromString("2012-01-01 09:00:00", "yyyy-MM-dd HH:mm:ss");
+	ActivityQuery span(0, "TeamRadar", start, start.addSecs(59 * 60), "HOUR", QStringList(), QStringList());
+	span.run(database);
+	QCOMPARE(span.getResult(), QList<QByteArray>() << "Developer3;SAVE;2012-01-01 09;2");
+	ActivityQuery renamed(0, "TeamRadar", QDateTime(), QDateTime(), "DAY",
+						  QStringList() << "Developer1" << "Developer2", QStringList());
+	renamed.run(database);
+	QVERIFY(renamed.getResult().isEmpty());
+
+	database = QSqlDatabase();
+	removeMainDB(dir);
+}
+
+// the encoded snapshot is reused until a member changes, and a member leaving is dropped from it
+void TeamRadarBench::snapshotCache()
+{
+	QString dir = createMainDB();
+	QVERIFY(!dir.isEmpty());
+	UsersModel::addUser("Developer1");
+	UsersModel::setProject("Developer1", "TeamRadar");
+	UsersModel::addUser("Developer2");
+	UsersModel::setProject("Developer2", "TeamRadar");
+	QVERIFY(QSqlQuery().exec("insert into Logs values (0, '2012-01-01 08:00:00', 'Developer1', 'SAVE', 'A.java')"));
+
+	SnapshotCache cache;
+	QByteArray snapshot = cache.getSnapshot("TeamRadar");
+	QCOMPARE(snapshot, Sender::makeTeamSnapshot(QList<QByteArray>() << "Developer1;#000000;TRUE;;A.java"
+																	<< "Developer2;#000000;TRUE;;"));
+	QVERIFY(cache.getSnapshot("TeamRadar").constData() == snapshot.constData());   // not encoded again
+
+	cache.setOnline  ("Developer2", false);
+	cache.setLocation("Developer1", "B.java");
+	cache.setColor   ("Developer3", "#ffffff");   // not a member of a loaded project
+	QCOMPARE(cache.getSnapshot("TeamRadar"), Sender::makeTeamSnapshot(QList<QByteArray>()
+																	  << "Developer1;#000000;TRUE;;B.java"
+																	  << "Developer2;#000000;FALSE;;"));
+
+	cache.setProject("Developer2", "Other");
+	QCOMPARE(cache.getSnapshot("TeamRadar"), Sender::makeTeamSnapshot(QList<QByteArray>()
+																	  << "Developer1;#000000;TRUE;;B.java"));
+	removeMainDB(dir);
+}
+
+// the jobs finish on the main thread, and find their connection gone if the client left meanwhile
+void TeamRadarBench::queryExecutor()
+{
+	QString dir = createMainDB();
+	QVERIFY(!dir.isEmpty());
+	QVERIFY(QSqlQuery().exec("insert into Logs values (0, '2012-01-01 08:00:00', 'Developer1', 'SAVE', 'A.java')"));
+	{
+		QueryExecutor executor;
+		executor.setDatabaseName(dir + "/TeamRadar.db");
+		Connection* staying = new Connection(new QBuffer, this);
+		Connection* leaving = new Connection(new QBuffer, this);
+		QAtomicInt counted1(-1);
+		QAtomicInt counted2(-1);
+		CountJob* job1 = new CountJob(&counted1, staying);
+		CountJob* job2 = new CountJob(&counted2, leaving);
+		connect(job1, SIGNAL(finished()), this, SLOT(onJobFinished()));
+		connect(job2, SIGNAL(finished()), this, SLOT(onJobFinished()));
+		jobConnections.clear();
+		executor.submit(job1);
+		executor.submit(job2);
+		delete leaving;
+
+		WAIT_FOR(jobConnections.size() == 2)
+		QCOMPARE(jobConnections.size(), 2);
+		QVERIFY(jobConnections.contains(staying));
+		QVERIFY(jobConnections.contains(0));
+		QCOMPARE(int(counted1), 1);
+		QCOMPARE(int(counted2), 1);
+		QCOMPARE(executor.getQueueDepth(), 0);
+		delete staying;
+	}
+	removeMainDB(dir);
+}
+
+// a second server on the host does not take over the local socket of a running one
+void TeamRadarBench::localSocketInUse()
+{
+	Server other;
+	QVERIFY(!other.listenLocal("TeamRadarBench"));
+
+	QLocalSocket client;
+	client.connectToServer("TeamRadarBench");
+	QVERIFY(client.waitForConnected(5000));
+	received = 0;
+	client.write(Sender::makePacket("GREETING", "LocalUser") +
+				 Sender::makePacket("EVENT", "SAVE#" + randomPath().toUtf8()));
+	WAIT_FOR(received == 1)
+	QCOMPARE(received, 1);   // still served by the first
+}
+
+QTEST_MAIN(TeamRadarBench)
+#include "TeamRadarBench.moc"
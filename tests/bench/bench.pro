@@ -0,0 +1,20 @@
+######################################################################
+# Micro-benchmarks for the codec, parser and phase paths
+# Build & run: qmake && make && ./bench
+# Comparable numbers: ./bench -iterations 10 (or -callgrind) on an idle box
+######################################################################
+
+TEMPLATE = app
+TARGET = bench
+CONFIG += console
+CONFIG -= app_bundle
+DEPENDPATH += .
+INCLUDEPATH += .
+
+QT += testlib
+
+# the server without its Main.cpp
+include(../../TeamRadarServer.pri)
+
+# Input
+SOURCES += TeamRadarBench.cpp
@@ -0,0 +1,31 @@
+#include "Replayer.h"
+#include <QCoreApplication>
+#include <QStringList>
+#include <QTextStream>
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+	QStringList args = app.arguments();
+	if(args.size() < 2)
+	{
+		QTextStream(stderr) << "Usage: replay capture-file [host] [port] [speed]\n"
+							   "  speed: 1 for real time, N for N times faster, max for no delay\n";
+		return 1;
+	}
+
+	QString host  = args.size() > 2 ? args.at(2) : "127.0.0.1";
+	quint16 port  = args.size() > 3 ? args.at(3).toUShort() : 12345;
+	double  speed = args.size() > 4 ? (args.at(4) == "max" ? 0 : args.at(4).toDouble()) : 1;
+
+	Replayer replayer(host, port, speed);
+	if(!replayer.load(args.at(1)))
+	{
+		QTextStream(stderr) << "Can not read capture " << args.at(1) << "\n";
+		return 1;
+	}
+
+	QObject::connect(&replayer, SIGNAL(finished()), &app, SLOT(quit()));
+	replayer.start();
+	return app.exec();
+}
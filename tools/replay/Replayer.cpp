@@ -0,0 +1,118 @@
+#include "Replayer.h"
+#include <QTcpSocket>
+#include <QTimer>
+#include <QFile>
+#include <QTextStream>
+
+Replayer::Replayer(const QString& h, quint16 p, double s, QObject* parent)
+	: QObject(parent), host(h), port(p), speed(s)
+{
+	current = 0;
+	bytesSent = bytesReceived = totalLag = maxLag = lastReply = 0;
+}
+
+bool Replayer::load(const QString& fileName)
+{
+	QFile file(fileName);
+	if(!file.open(QFile::ReadOnly))
+		return false;
+
+	QDataStream is(&file);
+	if(!PacketRecorder::readHeader(is))
+		return false;
+
+	CaptureRecord record;
+	while(PacketRecorder::readRecord(is, record))
+		records << record;
+	return true;
+}
+
+void Replayer::start()
+{
+	clock.start();
+	onTimeout();
+}
+
+void Replayer::onTimeout()
+{
+	// replay everything that is due
+	for(; current < records.size(); ++current)
+	{
+		const CaptureRecord& record = records.at(current);
+		qint64 due = speed > 0 ? qint64(record.time / speed) : 0;
+		qint64 now = clock.elapsed();
+		if(due > now)
+		{
+			QTimer::singleShot(due - now, this, SLOT(onTimeout()));
+			return;
+		}
+		totalLag += now - due;
+		maxLag = qMax(maxLag, now - due);
+		replay(record);
+	}
+
+	// all sent, wait for the replies
+	lastReply = clock.elapsed();
+	QTimer::singleShot(1000, this, SLOT(onDrained()));
+}
+
+void Replayer::replay(const CaptureRecord& record)
+{
+	QTcpSocket* socket = getSocket(record.connectionID);
+	if(record.type == CaptureRecord::Data)
+	{
+		socket->write(record.data);
+		bytesSent += record.data.size();
+	}
+	else if(record.type == CaptureRecord::Close)
+		socket->disconnectFromHost();
+}
+
+// a recorded connection is opened on its first record
+QTcpSocket* Replayer::getSocket(quint32 connectionID)
+{
+	if(!sockets.contains(connectionID))
+	{
+		QTcpSocket* socket = new QTcpSocket(this);
+		connect(socket, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
+		socket->connectToHost(host, port);
+		sockets.insert(connectionID, socket);
+	}
+	return sockets[connectionID];
+}
+
+void Replayer::onReadyRead()
+{
+	if(QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender()))
+	{
+		bytesReceived += socket->readAll().size();
+		lastReply = clock.elapsed();
+	}
+}
+
+// finished if no reply in the last second
+void Replayer::onDrained()
+{
+	qint64 idle = clock.elapsed() - lastReply;
+	if(idle < 1000)
+		QTimer::singleShot(1000 - idle, this, SLOT(onDrained()));
+	else
+	{
+		report();
+		emit finished();
+	}
+}
+
+void Replayer::report()
+{
+	QTextStream os(stdout);
+	qint64 elapsed = lastReply;
+	os << "Records:        " << records.size() << "\n"
+	   << "Connections:    " << sockets.size() << "\n"
+	   << "Bytes sent:     " << bytesSent      << "\n"
+	   << "Bytes received: " << bytesReceived  << "\n"
+	   << "Elapsed (ms):   " << elapsed        << "\n"
+	   << "Captured (ms):  " << (records.isEmpty() ? 0 : records.last().time) << "\n"
+	   << "Average lag (ms): " << (records.isEmpty() ? 0 : totalLag / records.size()) << "\n"
+	   << "Max lag (ms):   " << maxLag << "\n";
+}
@@ -0,0 +1,55 @@
+#ifndef Replayer_h__
+#define Replayer_h__
+
+#include <QObject>
+#include <QHostAddress>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include "PacketRecorder.h"
+
+class QTcpSocket;
+
+// Feeds a capture back into a server, one socket per recorded connection
+// speed: 1 for real time, N for N times faster, 0 for no delay
+class Replayer : public QObject
+{
+	Q_OBJECT
+
+public:
+	Replayer(const QString& host, quint16 port, double speed, QObject* parent = 0);
+	bool load(const QString& fileName);
+	void start();
+
+signals:
+	void finished();
+
+private slots:
+	void onTimeout();     // replay due records
+	void onReadyRead();   // count the replies
+	void onDrained();     // no more replies, print the report
+
+private:
+	void replay(const CaptureRecord& record);
+	QTcpSocket* getSocket(quint32 connectionID);
+	void report();
+
+private:
+	QString host;
+	quint16 port;
+	double  speed;
+
+	QList<CaptureRecord>         records;
+	int                          current;
+	QHash<quint32, QTcpSocket*>  sockets;    // connection id -> socket
+	QElapsedTimer                clock;
+
+	// statistics
+	qint64 bytesSent;
+	qint64 bytesReceived;
+	qint64 totalLag;     // msecs behind the schedule, summed
+	qint64 maxLag;
+	qint64 lastReply;    // time of the last reply, for the drain
+};
+
+#endif // Replayer_h__
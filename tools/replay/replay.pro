@@ -0,0 +1,22 @@
+######################################################################
+# Replays a capture of TeamRadarServer against a server instance
+# Usage: replay capture-file [host] [port] [speed]
+#   speed: 1 for real time, N for N times faster, max for no delay
+######################################################################
+
+TEMPLATE = app
+TARGET = replay
+CONFIG += console
+CONFIG -= app_bundle
+DEPENDPATH += . ../..
+INCLUDEPATH += . ../..
+
+QT -= gui
+QT += network
+
+# Input
+HEADERS += Replayer.h \
+		   ../../PacketRecorder.h
+SOURCES += Main.cpp \
+		   Replayer.cpp \
+		   ../../PacketRecorder.cpp